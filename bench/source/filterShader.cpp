@@ -0,0 +1,298 @@
+#include "vkHelper.h"
+#include "GltfIblSampler.h"
+#include "FilterParameters.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// renders the filter pass of one cube map mip level with every SPIR-V optimization stage of filter.frag
+// (see cmake/compile_shader.cmake) and compares the GPU time against the unoptimized output.
+// arguments: [face size = 256] [sample count = 1024] [iterations = 10]
+
+using Clock = std::chrono::high_resolution_clock;
+
+namespace
+{
+	// none is the glslang output without optimizer the library shipped before spirv-opt and the baseline of the comparison
+	const char* g_optimizations[] = { "none", "size", "inline", "performance" };
+
+	float pattern(uint32_t _x, uint32_t _y, uint32_t _layer, uint32_t _channel)
+	{
+		uint32_t hash = (_x * 73856093u) ^ (_y * 19349663u) ^ (_layer * 83492791u) ^ (_channel * 2654435761u);
+		hash ^= hash >> 13u;
+		return static_cast<float>(hash & 0xffffu) / 4096.f;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t sideLength = argc > 1 ? strtoul(argv[1], nullptr, 0) : 256u;
+	const uint32_t sampleCount = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1024u;
+	const uint32_t iterations = argc > 3 ? strtoul(argv[3], nullptr, 0) : 10u;
+
+	if (sideLength == 0u || iterations == 0u)
+	{
+		printf("usage: bench_filter_shader [face size] [sample count] [iterations]\n");
+		return -1;
+	}
+
+	IBLLib::vkHelper vulkan;
+
+	if (vulkan.initialize(0u, 1u, false) != VK_SUCCESS)
+	{
+		printf("Failed to initialize Vulkan\n");
+		return -1;
+	}
+
+	const VkFormat cubeMapFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+	const VkFormat LUTFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	uint32_t mipLevels = 0u;
+	for (uint32_t m = sideLength; m > 0u; m = m >> 1, ++mipLevels) {}
+
+	// the input varies per texel, so the samples do not all hit the same cache lines
+	VkImage inputCubeMap = VK_NULL_HANDLE;
+	if (vulkan.createImage2DAndAllocate(inputCubeMap, sideLength, sideLength, cubeMapFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		mipLevels, 6u, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) != VK_SUCCESS)
+	{
+		printf("Failed to create input cube map\n");
+		return -1;
+	}
+
+	const auto writeRows = [&](uint32_t _level, uint32_t _layer, uint32_t _firstRow, uint32_t _rowCount, void* _dst) -> bool
+	{
+		const uint32_t width = sideLength >> _level;
+		float* pDst = static_cast<float*>(_dst);
+		for (uint32_t y = _firstRow; y < _firstRow + _rowCount; ++y)
+		{
+			for (uint32_t x = 0u; x < width; ++x)
+			{
+				for (uint32_t c = 0u; c < 4u; ++c)
+				{
+					*pDst++ = c == 3u ? 1.f : pattern(x << _level, y << _level, _layer, c);
+				}
+			}
+		}
+		return true;
+	};
+
+	if (vulkan.uploadMipChainStreamed(inputCubeMap, writeRows, mipLevels) != VK_SUCCESS)
+	{
+		printf("Failed to upload input cube map\n");
+		return -1;
+	}
+
+	VkCommandBuffer cmd = VK_NULL_HANDLE;
+	if (vulkan.createCommandBuffer(cmd) != VK_SUCCESS || vulkan.beginCommandBuffer(cmd) != VK_SUCCESS)
+	{
+		return -1;
+	}
+
+	vulkan.imageBarrier(cmd, inputCubeMap, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+		{ VK_IMAGE_ASPECT_COLOR_BIT, 0u, mipLevels, 0u, 6u });
+
+	if (vulkan.endCommandBuffer(cmd) != VK_SUCCESS || vulkan.executeCommandBuffer(cmd) != VK_SUCCESS)
+	{
+		return -1;
+	}
+
+	VkImageView inputCubeMapView = VK_NULL_HANDLE;
+	if (vulkan.createImageView(inputCubeMapView, inputCubeMap, { VK_IMAGE_ASPECT_COLOR_BIT, 0u, mipLevels, 0u, 6u }, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_CUBE) != VK_SUCCESS)
+	{
+		return -1;
+	}
+
+	VkSampler cubeMipMapSampler = VK_NULL_HANDLE;
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		vulkan.fillSamplerCreateInfo(samplerInfo);
+		samplerInfo.maxLod = float(mipLevels + 1);
+
+		if (vulkan.createSampler(cubeMipMapSampler, samplerInfo) != VK_SUCCESS)
+		{
+			return -1;
+		}
+	}
+
+	// six faces and the LUT, like the filter pass of the library
+	std::vector<VkImageView> renderTargetViews;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	{
+		IBLLib::RenderPassDesc renderPassDesc;
+
+		for (uint32_t i = 0u; i < 7u; ++i)
+		{
+			const VkFormat format = i < 6u ? cubeMapFormat : LUTFormat;
+
+			VkImage target = VK_NULL_HANDLE;
+			VkImageView targetView = VK_NULL_HANDLE;
+			if (vulkan.createImage2DAndAllocate(target, sideLength, sideLength, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) != VK_SUCCESS ||
+				vulkan.createImageView(targetView, target) != VK_SUCCESS)
+			{
+				printf("Failed to create render targets\n");
+				return -1;
+			}
+
+			renderTargetViews.push_back(targetView);
+			renderPassDesc.addAttachment(format);
+		}
+
+		if (vulkan.createRenderPass(renderPass, renderPassDesc.getInfo()) != VK_SUCCESS)
+		{
+			return -1;
+		}
+	}
+
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	if (vulkan.createFramebuffer(framebuffer, renderPass, sideLength, sideLength, renderTargetViews) != VK_SUCCESS)
+	{
+		return -1;
+	}
+
+	std::vector<VkPushConstantRange> ranges(1u);
+	ranges.front().offset = 0u;
+	ranges.front().size = sizeof(IBLLib::FilterParameters);
+	ranges.front().stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSet filterDescriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout filterPipelineLayout = VK_NULL_HANDLE;
+	{
+		IBLLib::DescriptorSetInfo setLayout0;
+		setLayout0.addCombinedImageSampler(cubeMipMapSampler, inputCubeMapView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1u, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VkDescriptorSetLayout filterSetLayout = VK_NULL_HANDLE;
+		if (setLayout0.create(vulkan, filterSetLayout, filterDescriptorSet) != VK_SUCCESS)
+		{
+			return -1;
+		}
+
+		vulkan.updateDescriptorSets(setLayout0.getWrites());
+
+		if (vulkan.createPipelineLayout(filterPipelineLayout, filterSetLayout, ranges) != VK_SUCCESS)
+		{
+			return -1;
+		}
+	}
+
+	VkShaderModule fullscreenVertexShader = VK_NULL_HANDLE;
+	if (vulkan.loadShaderModule(fullscreenVertexShader, IBLSAMPLER_BENCH_SPIRV_DIR "/fullscreenVertex.spv") != VK_SUCCESS)
+	{
+		printf("Failed to load %s\n", IBLSAMPLER_BENCH_SPIRV_DIR "/fullscreenVertex.spv");
+		return -1;
+	}
+
+	const std::vector<VkClearValue> clearValues(7u, { 0.0f, 0.0f, 1.0f, 1.0f });
+
+	printf("face size %u, %u samples, %u mip levels, %u iterations\n", sideLength, sampleCount, mipLevels, iterations);
+	printf("optimization, SPIR-V [bytes], lambertian [ms], ggx [ms], charlie [ms], speedup to none\n");
+
+	double baselineTotal = 0.0;
+
+	for (const char* optimization : g_optimizations)
+	{
+		const std::string path = std::string(IBLSAMPLER_BENCH_SPIRV_DIR "/filterCubeMap.") + optimization + ".spv";
+
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == nullptr)
+		{
+			printf("%s, skipped (not built)\n", optimization);
+			continue;
+		}
+		fseek(file, 0, SEEK_END);
+		const long spirvBytes = ftell(file);
+		fclose(file);
+
+		VkShaderModule filterCubeMapFragmentShader = VK_NULL_HANDLE;
+		if (vulkan.loadShaderModule(filterCubeMapFragmentShader, path.c_str()) != VK_SUCCESS)
+		{
+			printf("Failed to load %s\n", path.c_str());
+			return -1;
+		}
+
+		VkPipeline filterPipeline = VK_NULL_HANDLE;
+		{
+			IBLLib::GraphicsPipelineDesc filterCubeMapPipelineDesc;
+
+			filterCubeMapPipelineDesc.addShaderStage(fullscreenVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "main");
+			filterCubeMapPipelineDesc.addShaderStage(filterCubeMapFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "filterCubeMap");
+
+			filterCubeMapPipelineDesc.setRenderPass(renderPass);
+			filterCubeMapPipelineDesc.setPipelineLayout(filterPipelineLayout);
+
+			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			colorBlendAttachment.blendEnable = VK_FALSE;
+
+			filterCubeMapPipelineDesc.addColorBlendAttachment(colorBlendAttachment, 7u);
+			filterCubeMapPipelineDesc.setViewportExtent(VkExtent2D{ sideLength, sideLength });
+
+			if (vulkan.createPipeline(filterPipeline, filterCubeMapPipelineDesc.getInfo()) != VK_SUCCESS)
+			{
+				printf("Failed to create pipeline for %s\n", optimization);
+				return -1;
+			}
+		}
+
+		double milliseconds[3] = {};
+
+		for (uint32_t distribution = 0u; distribution < 3u; ++distribution)
+		{
+			IBLLib::FilterParameters values{};
+			values.roughness = 0.5f;
+			values.sampleCount = sampleCount;
+			values.mipLevel = 0u;
+			values.width = sideLength;
+			values.distribution = static_cast<IBLLib::Distribution>(distribution);
+
+			if (vulkan.createCommandBuffer(cmd) != VK_SUCCESS || vulkan.beginCommandBuffer(cmd) != VK_SUCCESS)
+			{
+				return -1;
+			}
+
+			vulkan.bindDescriptorSet(cmd, filterPipelineLayout, filterDescriptorSet);
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, filterPipeline);
+			vkCmdPushConstants(cmd, filterPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(IBLLib::FilterParameters), &values);
+
+			vulkan.beginRenderPass(cmd, renderPass, framebuffer, VkRect2D{ 0u, 0u, sideLength, sideLength }, clearValues);
+			vkCmdDraw(cmd, 3, 1u, 0, 0);
+			vulkan.endRenderPass(cmd);
+
+			if (vulkan.endCommandBuffer(cmd) != VK_SUCCESS)
+			{
+				return -1;
+			}
+
+			// the first submission includes the driver's deferred shader compilation
+			if (vulkan.executeCommandBuffer(cmd) != VK_SUCCESS)
+			{
+				return -1;
+			}
+
+			const Clock::time_point start = Clock::now();
+			for (uint32_t i = 0u; i < iterations; ++i)
+			{
+				if (vulkan.executeCommandBuffer(cmd) != VK_SUCCESS)
+				{
+					return -1;
+				}
+			}
+			milliseconds[distribution] = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / static_cast<double>(iterations);
+
+			vulkan.destroyCommandBuffer(cmd);
+		}
+
+		const double total = milliseconds[0] + milliseconds[1] + milliseconds[2];
+		if (std::string(optimization) == "none")
+		{
+			baselineTotal = total;
+		}
+
+		printf("%s, %ld, %.3f, %.3f, %.3f, %.2fx\n", optimization, spirvBytes, milliseconds[0], milliseconds[1], milliseconds[2], baselineTotal > 0.0 ? baselineTotal / total : 1.0);
+	}
+
+	return 0;
+}
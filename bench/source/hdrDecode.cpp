@@ -0,0 +1,140 @@
+#include "HdrReader.h"
+#include "ThreadPool.h"
+#include "syntheticPanorama.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// compares decoding a Radiance .hdr panorama with stbi_loadf against HdrReader on one and on all threads.
+// without arguments 8k and 16k panoramas are generated in the working directory, otherwise the given files are used
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double millisecondsSince(Clock::time_point _start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+}
+
+static uint64_t checksum(const void* _data, size_t _bytes)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(_data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0u; i < _bytes; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static double decode(const char* _path, IBLLib::ThreadPool& _pool, VkFormat _format, uint32_t _texelSize, uint64_t& _outChecksum)
+{
+	const Clock::time_point start = Clock::now();
+
+	IBLLib::HdrReader reader;
+	if (reader.open(_path) != IBLLib::Success)
+	{
+		return -1.0;
+	}
+
+	// left uninitialized like the stbi_loadf result
+	const size_t imageSize = static_cast<size_t>(reader.getWidth()) * reader.getHeight() * _texelSize;
+	std::unique_ptr<uint8_t[]> image(new uint8_t[imageSize]);
+
+	// same band size as a 16 MiB staging chunk of the upload
+	const uint32_t bandRows = std::max(1u, (16u << 20) / (reader.getWidth() * _texelSize));
+	const size_t rowPitch = static_cast<size_t>(reader.getWidth()) * _texelSize;
+
+	for (uint32_t row = 0u; row < reader.getHeight(); row += bandRows)
+	{
+		const uint32_t rowCount = std::min(bandRows, reader.getHeight() - row);
+		if (reader.readScanlines(rowCount, image.get() + row * rowPitch, _format, _pool) != IBLLib::Success)
+		{
+			return -1.0;
+		}
+	}
+
+	const double time = millisecondsSince(start);
+	_outChecksum = checksum(image.get(), imageSize);
+	return time;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		paths.push_back(argv[i]);
+	}
+
+	if (paths.empty())
+	{
+		const uint32_t widths[] = { 8192u, 16384u };
+		for (uint32_t width : widths)
+		{
+			const std::string path = "bench_panorama_" + std::to_string(width / 1024u) + "k.hdr";
+			printf("Generating %s\n", path.c_str());
+
+			if (writeSyntheticPanorama(path.c_str(), width, width / 2u, true) == false)
+			{
+				printf("Failed to write %s\n", path.c_str());
+				return -1;
+			}
+
+			paths.push_back(path);
+		}
+	}
+
+	IBLLib::ThreadPool singleThread(1u);
+	IBLLib::ThreadPool allThreads;
+
+	printf("file, stbi_loadf [ms], HdrReader float 1 thread [ms], HdrReader float %u threads [ms], HdrReader half %u threads [ms], identical\n",
+		allThreads.getThreadCount(), allThreads.getThreadCount());
+
+	for (const std::string& path : paths)
+	{
+		Clock::time_point start = Clock::now();
+
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		float* stbData = stbi_loadf(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		const double stbTime = millisecondsSince(start);
+
+		if (stbData == nullptr)
+		{
+			printf("Failed to load %s: %s\n", path.c_str(), stbi_failure_reason());
+			return -1;
+		}
+
+		const uint64_t stbChecksum = checksum(stbData, static_cast<size_t>(width) * height * 4u * sizeof(float));
+		stbi_image_free(stbData);
+
+		uint64_t singleChecksum = 0u;
+		uint64_t parallelChecksum = 0u;
+		uint64_t halfChecksum = 0u;
+
+		const double singleTime = decode(path.c_str(), singleThread, VK_FORMAT_R32G32B32A32_SFLOAT, 16u, singleChecksum);
+		const double parallelTime = decode(path.c_str(), allThreads, VK_FORMAT_R32G32B32A32_SFLOAT, 16u, parallelChecksum);
+		const double halfTime = decode(path.c_str(), allThreads, VK_FORMAT_R16G16B16A16_SFLOAT, 8u, halfChecksum);
+
+		if (singleTime < 0.0 || parallelTime < 0.0 || halfTime < 0.0)
+		{
+			printf("Failed to decode %s\n", path.c_str());
+			return -1;
+		}
+
+		const bool identical = stbChecksum == singleChecksum && stbChecksum == parallelChecksum;
+
+		printf("%s, %.1f, %.1f, %.1f, %.1f, %s\n", path.c_str(), stbTime, singleTime, parallelTime, halfTime, identical ? "yes" : "no");
+	}
+
+	return 0;
+}
@@ -0,0 +1,480 @@
+#include "GltfIblSampler.h"
+#include "syntheticPanorama.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// runs IBLLib::sample over every combination of input, cube map resolution, sample count, distribution and output
+// format and reports the median time of every stage as CSV and JSON. runs on any Vulkan driver, software drivers
+// like lavapipe are picked with VK_ICD_FILENAMES. see usage() for the arguments
+
+using namespace IBLLib;
+
+namespace
+{
+	struct Stage
+	{
+		const char* name;
+		double Statistics::* value;
+	};
+
+	// column order of the reports, keep it stable for regression tracking
+	const Stage g_stages[] = {
+		{ "initialize", &Statistics::initialize },
+		{ "decode", &Statistics::decode },
+		{ "upload", &Statistics::upload },
+		{ "panorama_to_cube_map", &Statistics::panoramaToCubeMap },
+		{ "mip_generation", &Statistics::mipGeneration },
+		{ "filter", &Statistics::filter },
+		{ "format_conversion", &Statistics::formatConversion },
+		{ "execute", &Statistics::execute },
+		{ "readback", &Statistics::readback },
+		{ "write", &Statistics::write },
+		{ "total", &Statistics::total }
+	};
+
+	const char* g_distributionNames[] = { "Lambertian", "GGX", "Charlie" };
+
+	struct FormatName
+	{
+		OutputFormat format;
+		const char* name;
+	};
+
+	const FormatName g_formatNames[] = {
+		{ OutputFormat::R8G8B8A8_UNORM, "R8G8B8A8_UNORM" },
+		{ OutputFormat::R16G16B16A16_SFLOAT, "R16G16B16A16_SFLOAT" },
+		{ OutputFormat::R32G32B32A32_SFLOAT, "R32G32B32A32_SFLOAT" }
+	};
+
+	struct Case
+	{
+		std::string input;
+		uint32_t resolution = 0u;
+		uint32_t sampleCount = 0u;
+		uint32_t distribution = 0u; // index into g_distributionNames
+		uint32_t format = 0u; // index into g_formatNames
+	};
+
+	struct Row
+	{
+		Case config;
+		Statistics median;
+	};
+
+	void usage()
+	{
+		printf("ibl_bench usage:\n");
+		printf("-inputs: comma separated panoramas or KTX2 cube maps\n");
+		printf("-synthetic: width of a generated radiance panorama, used if no inputs are given (default = 2048)\n");
+		printf("-resolutions: comma separated cube map resolutions (default = 128,256,512)\n");
+		printf("-sampleCounts: comma separated sample counts (default = 64,1024)\n");
+		printf("-distributions: comma separated distributions (default = Lambertian,GGX,Charlie)\n");
+		printf("-formats: comma separated output formats (default = R16G16B16A16_SFLOAT)\n");
+		printf("-repeat: measured runs per configuration, the median is reported (default = 5)\n");
+		printf("-warmup: unmeasured runs per configuration, these fill the pipeline cache (default = 1)\n");
+		printf("-csv: output path of the CSV report (default = ibl_bench.csv)\n");
+		printf("-json: output path of the JSON report (default = ibl_bench.json)\n");
+		printf("-pipelineCache: directory of the Vulkan pipeline cache, empty to disable\n");
+	}
+
+	std::vector<std::string> split(const char* _list)
+	{
+		std::vector<std::string> items;
+		std::string item;
+
+		for (const char* c = _list; ; ++c)
+		{
+			if (*c == ',' || *c == '\0')
+			{
+				if (item.empty() == false)
+				{
+					items.push_back(item);
+				}
+				item.clear();
+
+				if (*c == '\0')
+				{
+					break;
+				}
+			}
+			else
+			{
+				item.push_back(*c);
+			}
+		}
+
+		return items;
+	}
+
+	bool parseNumbers(const char* _list, std::vector<uint32_t>& _out)
+	{
+		_out.clear();
+		for (const std::string& item : split(_list))
+		{
+			const uint32_t value = strtoul(item.c_str(), nullptr, 0);
+			if (value == 0u)
+			{
+				printf("Invalid number %s\n", item.c_str());
+				return false;
+			}
+			_out.push_back(value);
+		}
+		return _out.empty() == false;
+	}
+
+	bool parseDistributions(const char* _list, std::vector<uint32_t>& _out)
+	{
+		_out.clear();
+		for (const std::string& item : split(_list))
+		{
+			uint32_t i = 0u;
+			while (i < 3u && item != g_distributionNames[i]) { ++i; }
+
+			if (i == 3u)
+			{
+				printf("Unknown distribution %s\n", item.c_str());
+				return false;
+			}
+			_out.push_back(i);
+		}
+		return _out.empty() == false;
+	}
+
+	bool parseFormats(const char* _list, std::vector<uint32_t>& _out)
+	{
+		_out.clear();
+		for (const std::string& item : split(_list))
+		{
+			uint32_t i = 0u;
+			while (i < 3u && item != g_formatNames[i].name) { ++i; }
+
+			if (i == 3u)
+			{
+				printf("Unknown format %s\n", item.c_str());
+				return false;
+			}
+			_out.push_back(i);
+		}
+		return _out.empty() == false;
+	}
+
+	double median(std::vector<double>& _values)
+	{
+		std::sort(_values.begin(), _values.end());
+		const size_t middle = _values.size() / 2u;
+		return _values.size() % 2u == 1u ? _values[middle] : 0.5 * (_values[middle - 1u] + _values[middle]);
+	}
+
+	Statistics medianStatistics(const std::vector<Statistics>& _runs)
+	{
+		Statistics result;
+		std::vector<double> values(_runs.size());
+
+		for (const Stage& stage : g_stages)
+		{
+			for (size_t r = 0u; r < _runs.size(); ++r)
+			{
+				values[r] = _runs[r].*stage.value;
+			}
+			result.*stage.value = median(values);
+		}
+
+		// every run of a configuration filters the same number of levels
+		result.filterMips.resize(_runs.front().filterMips.size());
+		for (size_t level = 0u; level < result.filterMips.size(); ++level)
+		{
+			for (size_t r = 0u; r < _runs.size(); ++r)
+			{
+				values[r] = _runs[r].filterMips[level];
+			}
+			result.filterMips[level] = median(values);
+		}
+
+		result.gpuTimestamps = _runs.front().gpuTimestamps;
+
+		// memory peaks are the worst run, not the median
+		for (const Statistics& run : _runs)
+		{
+			result.peakDeviceBytes = std::max(result.peakDeviceBytes, run.peakDeviceBytes);
+			result.peakHostBytes = std::max(result.peakHostBytes, run.peakHostBytes);
+		}
+
+		return result;
+	}
+
+	// filter mip times are one column, separated by ';' from level 0 to the smallest level. memory peaks come last
+	bool writeCsv(const char* _path, const std::vector<Row>& _rows, uint32_t _repeat)
+	{
+		FILE* file = fopen(_path, "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		fprintf(file, "input,resolution,sample_count,distribution,format,runs,gpu_timestamps");
+		for (const Stage& stage : g_stages)
+		{
+			fprintf(file, ",%s_ms", stage.name);
+		}
+		fprintf(file, ",filter_mips_ms,peak_device_bytes,peak_host_bytes\n");
+
+		for (const Row& row : _rows)
+		{
+			fprintf(file, "%s,%u,%u,%s,%s,%u,%u", row.config.input.c_str(), row.config.resolution, row.config.sampleCount,
+				g_distributionNames[row.config.distribution], g_formatNames[row.config.format].name, _repeat, row.median.gpuTimestamps ? 1u : 0u);
+
+			for (const Stage& stage : g_stages)
+			{
+				fprintf(file, ",%.3f", row.median.*stage.value);
+			}
+
+			fprintf(file, ",");
+			for (size_t level = 0u; level < row.median.filterMips.size(); ++level)
+			{
+				fprintf(file, level == 0u ? "%.3f" : ";%.3f", row.median.filterMips[level]);
+			}
+			fprintf(file, ",%llu,%llu\n", row.median.peakDeviceBytes, row.median.peakHostBytes);
+		}
+
+		fclose(file);
+		return true;
+	}
+
+	void writeJsonString(FILE* _file, const std::string& _value)
+	{
+		fputc('"', _file);
+		for (const char c : _value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				fputc('\\', _file);
+			}
+			fputc(c, _file);
+		}
+		fputc('"', _file);
+	}
+
+	bool writeJson(const char* _path, const std::vector<Row>& _rows, uint32_t _repeat, uint32_t _warmup)
+	{
+		FILE* file = fopen(_path, "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		fprintf(file, "{\n\t\"unit\": \"ms\",\n\t\"statistic\": \"median\",\n\t\"runs\": %u,\n\t\"warmup\": %u,\n\t\"results\": [", _repeat, _warmup);
+
+		for (size_t i = 0u; i < _rows.size(); ++i)
+		{
+			const Row& row = _rows[i];
+
+			fprintf(file, i == 0u ? "\n\t\t{ \"input\": " : ",\n\t\t{ \"input\": ");
+			writeJsonString(file, row.config.input);
+			fprintf(file, ", \"resolution\": %u, \"sample_count\": %u, \"distribution\": \"%s\", \"format\": \"%s\", \"gpu_timestamps\": %s",
+				row.config.resolution, row.config.sampleCount, g_distributionNames[row.config.distribution], g_formatNames[row.config.format].name,
+				row.median.gpuTimestamps ? "true" : "false");
+
+			for (const Stage& stage : g_stages)
+			{
+				fprintf(file, ", \"%s\": %.3f", stage.name, row.median.*stage.value);
+			}
+
+			fprintf(file, ", \"filter_mips\": [");
+			for (size_t level = 0u; level < row.median.filterMips.size(); ++level)
+			{
+				fprintf(file, level == 0u ? "%.3f" : ", %.3f", row.median.filterMips[level]);
+			}
+			fprintf(file, "], \"peak_device_bytes\": %llu, \"peak_host_bytes\": %llu }", row.median.peakDeviceBytes, row.median.peakHostBytes);
+		}
+
+		fprintf(file, "\n\t]\n}\n");
+
+		fclose(file);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> inputs;
+	uint32_t syntheticWidth = 0u;
+	std::vector<uint32_t> resolutions = { 128u, 256u, 512u };
+	std::vector<uint32_t> sampleCounts = { 64u, 1024u };
+	std::vector<uint32_t> distributions = { 0u, 1u, 2u };
+	std::vector<uint32_t> formats = { 1u };
+	uint32_t repeat = 5u;
+	uint32_t warmup = 1u;
+	const char* csvPath = "ibl_bench.csv";
+	const char* jsonPath = "ibl_bench.json";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+		{
+			usage();
+			return 0;
+		}
+
+		// every other argument takes a value
+		const char* nextArg = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (nextArg == nullptr)
+		{
+			usage();
+			return -1;
+		}
+
+		bool valid = true;
+
+		if (strcmp(argv[i], "-inputs") == 0)
+		{
+			inputs = split(nextArg);
+		}
+		else if (strcmp(argv[i], "-synthetic") == 0)
+		{
+			syntheticWidth = strtoul(nextArg, nullptr, 0);
+			valid = syntheticWidth >= 16u;
+		}
+		else if (strcmp(argv[i], "-resolutions") == 0)
+		{
+			valid = parseNumbers(nextArg, resolutions);
+		}
+		else if (strcmp(argv[i], "-sampleCounts") == 0)
+		{
+			valid = parseNumbers(nextArg, sampleCounts);
+		}
+		else if (strcmp(argv[i], "-distributions") == 0)
+		{
+			valid = parseDistributions(nextArg, distributions);
+		}
+		else if (strcmp(argv[i], "-formats") == 0)
+		{
+			valid = parseFormats(nextArg, formats);
+		}
+		else if (strcmp(argv[i], "-repeat") == 0)
+		{
+			repeat = strtoul(nextArg, nullptr, 0);
+			valid = repeat > 0u;
+		}
+		else if (strcmp(argv[i], "-warmup") == 0)
+		{
+			warmup = strtoul(nextArg, nullptr, 0);
+		}
+		else if (strcmp(argv[i], "-csv") == 0)
+		{
+			csvPath = nextArg;
+		}
+		else if (strcmp(argv[i], "-json") == 0)
+		{
+			jsonPath = nextArg;
+		}
+		else if (strcmp(argv[i], "-pipelineCache") == 0)
+		{
+			setPipelineCacheDirectory(nextArg);
+		}
+		else
+		{
+			printf("Unknown argument %s\n", argv[i]);
+			valid = false;
+		}
+
+		if (valid == false)
+		{
+			usage();
+			return -1;
+		}
+
+		++i;
+	}
+
+	if (inputs.empty() && syntheticWidth == 0u)
+	{
+		syntheticWidth = 2048u;
+	}
+
+	if (syntheticWidth != 0u)
+	{
+		const std::string path = "ibl_bench_synthetic_" + std::to_string(syntheticWidth) + ".hdr";
+		if (writeSyntheticPanorama(path.c_str(), syntheticWidth, syntheticWidth / 2u, false) == false)
+		{
+			printf("Failed to write %s\n", path.c_str());
+			return -1;
+		}
+		inputs.insert(inputs.begin(), path);
+	}
+
+	std::vector<Case> cases;
+	for (const std::string& input : inputs)
+	{
+		for (uint32_t resolution : resolutions)
+		{
+			for (uint32_t sampleCount : sampleCounts)
+			{
+				for (uint32_t distribution : distributions)
+				{
+					for (uint32_t format : formats)
+					{
+						Case config;
+						config.input = input;
+						config.resolution = resolution;
+						config.sampleCount = sampleCount;
+						config.distribution = distribution;
+						config.format = format;
+						cases.push_back(config);
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<Row> rows;
+	std::vector<Statistics> runs;
+
+	for (size_t c = 0u; c < cases.size(); ++c)
+	{
+		const Case& config = cases[c];
+		printf("[%u/%u] %s %u %u %s %s\n", static_cast<uint32_t>(c + 1u), static_cast<uint32_t>(cases.size()), config.input.c_str(),
+			config.resolution, config.sampleCount, g_distributionNames[config.distribution], g_formatNames[config.format].name);
+
+		runs.clear();
+		bool failed = false;
+
+		for (uint32_t run = 0u; run < warmup + repeat && failed == false; ++run)
+		{
+			Statistics statistics;
+			failed = sample(config.input.c_str(), "ibl_bench_cube.ktx2", "ibl_bench_lut.png", static_cast<Distribution>(config.distribution),
+				config.resolution, 0u, config.sampleCount, g_formatNames[config.format].format, 0.0f, false, &statistics) != Result::Success;
+
+			if (run >= warmup)
+			{
+				runs.push_back(statistics);
+			}
+		}
+
+		if (failed)
+		{
+			printf("Failed, skipping this configuration\n");
+			continue;
+		}
+
+		Row row;
+		row.config = config;
+		row.median = medianStatistics(runs);
+		rows.push_back(row);
+	}
+
+	if (writeCsv(csvPath, rows, repeat) == false || writeJson(jsonPath, rows, repeat, warmup) == false)
+	{
+		printf("Failed to write the reports\n");
+		return -1;
+	}
+
+	printf("Wrote %s and %s\n", csvPath, jsonPath);
+
+	return rows.size() == cases.size() ? 0 : -1;
+}
@@ -0,0 +1,102 @@
+#include "vkHelper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+
+// measures vkHelper resource bookkeeping cost per call for growing resource counts,
+// the per call cost should stay flat as the number of live resources grows
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double nanosecondsPerCall(Clock::time_point _start, Clock::time_point _end, size_t _calls)
+{
+	return std::chrono::duration<double, std::nano>(_end - _start).count() / static_cast<double>(_calls);
+}
+
+int main(int argc, char* argv[])
+{
+	IBLLib::vkHelper vulkan;
+
+	if (vulkan.initialize(0u, 1u, false) != VK_SUCCESS)
+	{
+		printf("Failed to initialize Vulkan\n");
+		return -1;
+	}
+
+	const uint32_t resourceCounts[] = { 16u, 64u, 256u, 1024u, 4096u };
+	constexpr uint32_t lookupCount = 100000u;
+
+	std::mt19937 rng(42u);
+	uint8_t payload[64] = {};
+
+	printf("resources, getCreateInfo [ns], writeBufferData [ns], destroyImage [ns], destroyBuffer [ns]\n");
+
+	for (uint32_t count : resourceCounts)
+	{
+		std::vector<VkImage> images(count, VK_NULL_HANDLE);
+		std::vector<VkBuffer> buffers(count, VK_NULL_HANDLE);
+
+		for (uint32_t i = 0u; i < count; ++i)
+		{
+			if (vulkan.createImage2DAndAllocate(images[i], 4u, 4u, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT) != VK_SUCCESS ||
+				vulkan.createBufferAndAllocate(buffers[i], sizeof(payload), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != VK_SUCCESS)
+			{
+				printf("Failed to create %u resources\n", count);
+				return -1;
+			}
+		}
+
+		std::uniform_int_distribution<uint32_t> pick(0u, count - 1u);
+		std::vector<uint32_t> indices(lookupCount);
+		for (uint32_t& index : indices)
+		{
+			index = pick(rng);
+		}
+
+		uint32_t checksum = 0u;
+
+		Clock::time_point start = Clock::now();
+		for (uint32_t index : indices)
+		{
+			checksum += vulkan.getCreateInfo(images[index])->extent.width;
+		}
+		const double lookupTime = nanosecondsPerCall(start, Clock::now(), lookupCount);
+
+		start = Clock::now();
+		for (uint32_t index : indices)
+		{
+			vulkan.writeBufferData(buffers[index], payload, sizeof(payload));
+		}
+		const double writeTime = nanosecondsPerCall(start, Clock::now(), lookupCount);
+
+		// release in random order to hit removal from the middle
+		std::shuffle(images.begin(), images.end(), rng);
+		std::shuffle(buffers.begin(), buffers.end(), rng);
+
+		start = Clock::now();
+		for (VkImage image : images)
+		{
+			vulkan.destroyImage(image);
+		}
+		const double destroyImageTime = nanosecondsPerCall(start, Clock::now(), count);
+
+		start = Clock::now();
+		for (VkBuffer buffer : buffers)
+		{
+			vulkan.destroyBuffer(buffer);
+		}
+		const double destroyBufferTime = nanosecondsPerCall(start, Clock::now(), count);
+
+		if (checksum != lookupCount * 4u)
+		{
+			printf("Invalid create info returned\n");
+			return -1;
+		}
+
+		printf("%u, %.1f, %.1f, %.1f, %.1f\n", count, lookupTime, writeTime, destroyImageTime, destroyBufferTime);
+	}
+
+	return 0;
+}
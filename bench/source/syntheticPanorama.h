@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Radiance .hdr panorama generator shared by the benchmarks
+
+// run length encodes one channel of a scanline the way common writers do (runs of 3 or more)
+inline void encodeSyntheticPanoramaChannel(const std::vector<uint8_t>& _row, uint32_t _channel, uint32_t _width, std::vector<uint8_t>& _out)
+{
+	uint32_t x = 0u;
+	while (x < _width)
+	{
+		uint32_t run = 1u;
+		while (x + run < _width && run < 127u && _row[4u * (x + run) + _channel] == _row[4u * x + _channel])
+		{
+			++run;
+		}
+
+		if (run >= 3u)
+		{
+			_out.push_back(static_cast<uint8_t>(128u + run));
+			_out.push_back(_row[4u * x + _channel]);
+			x += run;
+			continue;
+		}
+
+		uint32_t dump = 0u;
+		while (x + dump < _width && dump < 128u)
+		{
+			const uint32_t i = x + dump;
+			if (i + 2u < _width && _row[4u * i + _channel] == _row[4u * (i + 1u) + _channel] && _row[4u * i + _channel] == _row[4u * (i + 2u) + _channel])
+			{
+				break;
+			}
+			++dump;
+		}
+
+		_out.push_back(static_cast<uint8_t>(dump));
+		for (uint32_t i = 0u; i < dump; ++i)
+		{
+			_out.push_back(_row[4u * (x + i) + _channel]);
+		}
+		x += dump;
+	}
+}
+
+// sky like gradient with a sun and some noise, compresses roughly like captured panoramas.
+// without _rle the RGBE scanlines are stored flat, red and green are then kept at 16 or above so no texel can be
+// mistaken for the start of an encoded scanline
+inline bool writeSyntheticPanorama(const char* _path, uint32_t _width, uint32_t _height, bool _rle)
+{
+	FILE* file = fopen(_path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", _height, _width);
+
+	std::vector<uint8_t> row(4u * _width);
+	std::vector<uint8_t> encoded;
+	uint32_t noise = 12345u;
+
+	for (uint32_t y = 0u; y < _height; ++y)
+	{
+		for (uint32_t x = 0u; x < _width; ++x)
+		{
+			const float u = static_cast<float>(x) / _width;
+			const float v = static_cast<float>(y) / _height;
+			const float sun = std::exp(-((u - 0.3f) * (u - 0.3f) + (v - 0.2f) * (v - 0.2f)) * 4000.0f) * 5000.0f;
+
+			noise = noise * 1664525u + 1013904223u;
+			const float grain = ((noise >> 24) & 0x7u) * 0.002f;
+
+			const float rgb[3] = { 0.2f + 0.8f * v + sun + grain, 0.3f + 0.6f * v + sun, 0.9f - 0.5f * v + sun * 0.8f };
+			const float maxChannel = std::max(std::max(rgb[0], rgb[1]), rgb[2]);
+
+			int exponent = 0;
+			const float mantissa = std::frexp(maxChannel, &exponent) * 256.0f / maxChannel;
+
+			for (uint32_t c = 0u; c < 3u; ++c)
+			{
+				row[4u * x + c] = static_cast<uint8_t>(_rle ? rgb[c] * mantissa : std::max(rgb[c] * mantissa, 16.0f));
+			}
+			row[4u * x + 3u] = static_cast<uint8_t>(exponent + 128);
+		}
+
+		if (_rle == false)
+		{
+			fwrite(row.data(), 1u, row.size(), file);
+			continue;
+		}
+
+		encoded.clear();
+		encoded.push_back(2u);
+		encoded.push_back(2u);
+		encoded.push_back(static_cast<uint8_t>(_width >> 8));
+		encoded.push_back(static_cast<uint8_t>(_width & 0xffu));
+
+		for (uint32_t c = 0u; c < 4u; ++c)
+		{
+			encodeSyntheticPanoramaChannel(row, c, _width, encoded);
+		}
+
+		fwrite(encoded.data(), 1u, encoded.size(), file);
+	}
+
+	fclose(file);
+	return true;
+}
@@ -2,13 +2,14 @@
 #include <cstring>
 #include <stdio.h>
 #include <stdlib.h> 
+#include <vector>
 
 using namespace IBLLib;
 
 int main(int argc, char* argv[])
 {
-	const char* pathIn = nullptr;
-	const char* pathOutCubeMap = nullptr;
+	std::vector<const char*> pathsIn;
+	std::vector<const char*> pathsOutCubeMap;
 	const char* pathOutLUT = nullptr;
 	unsigned int sampleCount = 1024u;
 	unsigned int mipLevelCount = 0u;
@@ -17,6 +18,8 @@ int main(int argc, char* argv[])
 	Distribution distribution = Distribution::GGX;
 	float lodBias = 0.0f;
 	bool enableDebugOutput = false;
+	bool printStatistics = false;
+	const char* tracePath = nullptr;
 
 	const char* targetFormatString = "R16G16B16A16_SFLOAT";
 	const char* distributionString = "GGX";
@@ -27,8 +30,8 @@ int main(int argc, char* argv[])
 	{
 		printf("glTF-IBL-Sampler usage:\n");
 
-		printf("-inputPath: path to panorama image (default) or cube map (if inputIsCubeMap flag ist set) \n");
-		printf("-outCubeMap: output path for filtered cube map\n");
+		printf("-inputPath: path to panorama image or KTX2 cube map (detected from the file). repeat it to filter several inputs of the same kind and resolution together\n");
+		printf("-outCubeMap: output path for filtered cube map. with several inputs either one path per input or a single path for a KTX2 cube map array\n");
 		printf("-outLUT output path for BRDF LUT\n");
 		printf("-distribution NDF to sample (Lambertian, GGX, Charlie)\n");
 		printf("-sampleCount: number of samples used for filtering (default = 1024)\n");
@@ -36,6 +39,9 @@ int main(int argc, char* argv[])
 		printf("-cubeMapResolution: resolution of output cube map.  If omitted, an optimal resolution is chosen, based on the input panorama's resolution.\n");
 		printf("-targetFormat: specify output texture format (R8G8B8A8_UNORM, R16G16B16A16_SFLOAT, R32G32B32A32_SFLOAT)  \n");
 		printf("-lodBias: level of detail bias applied to filtering (default = 0) \n");
+		printf("-pipelineCache: directory of the Vulkan pipeline cache, empty to disable (default = IBLSAMPLER_PIPELINE_CACHE_DIR or the user cache directory)\n");
+		printf("-statistics: print the time spent in every stage and the peak device and host memory, GPU passes are timed with timestamp queries\n");
+		printf("-trace: output path of a chrome trace JSON with the CPU and GPU timeline, opens in Perfetto\n");
 
 
 		return 0;
@@ -44,13 +50,13 @@ int main(int argc, char* argv[])
 	for (int i = 1; i < argc; ++i)
 	{
 		const char* nextArg = i + 1 < argc ? argv[i+1] : nullptr;
-		if (strcmp(argv[i], "-inputPath") == 0)
+		if (strcmp(argv[i], "-inputPath") == 0 && nextArg != nullptr)
 		{
-			pathIn = nextArg;
+			pathsIn.push_back(nextArg);
 		}
-		else if (strcmp(argv[i], "-outCubeMap") == 0)
+		else if (strcmp(argv[i], "-outCubeMap") == 0 && nextArg != nullptr)
 		{
-			pathOutCubeMap = nextArg;
+			pathsOutCubeMap.push_back(nextArg);
 		}
 		else if (strcmp(argv[i], "-outLUT") == 0)
 		{
@@ -110,22 +116,40 @@ int main(int argc, char* argv[])
 		{
 			enableDebugOutput = true;
 		}
+		else if (strcmp(argv[i], "-statistics") == 0)
+		{
+			printStatistics = true;
+		}
+		else if (strcmp(argv[i], "-trace") == 0)
+		{
+			tracePath = nextArg;
+		}
+		else if (strcmp(argv[i], "-pipelineCache") == 0 && nextArg != nullptr)
+		{
+			setPipelineCacheDirectory(nextArg);
+		}
 	}
 
 	if (argc == 2)
 	{
-		pathIn = argv[1];
+		pathsIn.push_back(argv[1]);
 	}
 
-	if (pathIn == nullptr) 
+	if (pathsIn.empty()) 
 	{
 		printf("Input path not set. Set input path with -inputPath.\n");
 		return -1;
 	}
 
-	if (pathOutCubeMap == nullptr)
+	if (pathsOutCubeMap.empty())
 	{
-		pathOutCubeMap = "outputCubeMap.ktx2";
+		pathsOutCubeMap.push_back("outputCubeMap.ktx2");
+	}
+
+	if (pathsOutCubeMap.size() != 1u && pathsOutCubeMap.size() != pathsIn.size())
+	{
+		printf("Set one -outCubeMap per -inputPath or a single one for a cube map array.\n");
+		return -1;
 	}
 
 	if (pathOutLUT == nullptr)
@@ -133,8 +157,15 @@ int main(int argc, char* argv[])
 		pathOutLUT = "outputLUT.png";
 	}
 
-	printf("inputPath set to %s \n", pathIn);
-	printf("outCubeMap set to %s \n", pathOutCubeMap);
+	for (const char* pathIn : pathsIn)
+	{
+		printf("inputPath set to %s \n", pathIn);
+	}
+
+	for (const char* pathOutCubeMap : pathsOutCubeMap)
+	{
+		printf("outCubeMap set to %s \n", pathOutCubeMap);
+	}
 
 	if (pathOutLUT != nullptr)
 	{
@@ -148,12 +179,58 @@ int main(int argc, char* argv[])
 	printf("lodBias set to %f \n", lodBias);
 	printf("debug flag is set to %s\n", enableDebugOutput ? "True" : "False");
 
-	Result res = sample(pathIn, pathOutCubeMap, pathOutLUT, distribution, cubeMapResolution, mipLevelCount, sampleCount, targetFormat, lodBias, enableDebugOutput);
+	if (tracePath != nullptr)
+	{
+		beginTrace();
+	}
+
+	Statistics statistics;
+	Result res = sampleArray(pathsIn, pathsOutCubeMap, pathOutLUT, distribution, cubeMapResolution, mipLevelCount, sampleCount, targetFormat, lodBias, enableDebugOutput, printStatistics ? &statistics : nullptr);
+
+	// failed runs are traced as well
+	if (tracePath != nullptr && endTrace(tracePath) == Result::Success)
+	{
+		printf("Trace written to %s\n", tracePath);
+	}
 
 	if (res != Result::Success)
 	{
 		return -1;
 	}
 
+	if (printStatistics)
+	{
+		const char* gpuClock = statistics.gpuTimestamps ? "GPU" : "wall clock";
+
+		printf("initialize:            %8.2f ms\n", statistics.initialize);
+		printf("decode:                %8.2f ms\n", statistics.decode);
+		printf("upload:                %8.2f ms\n", statistics.upload);
+		printf("panorama to cube map:  %8.2f ms %s\n", statistics.panoramaToCubeMap, gpuClock);
+		printf("mip generation:        %8.2f ms %s\n", statistics.mipGeneration, gpuClock);
+		printf("filter:                %8.2f ms %s\n", statistics.filter, gpuClock);
+		for (size_t level = 0u; level < statistics.filterMips.size(); ++level)
+		{
+			printf("  mip %2u:              %8.2f ms\n", static_cast<unsigned int>(level), statistics.filterMips[level]);
+		}
+		printf("format conversion:     %8.2f ms %s\n", statistics.formatConversion, gpuClock);
+		printf("execute:               %8.2f ms\n", statistics.execute);
+		printf("readback:              %8.2f ms\n", statistics.readback);
+		printf("write:                 %8.2f ms\n", statistics.write);
+		printf("total:                 %8.2f ms\n", statistics.total);
+
+		const double mebibyte = 1024.0 * 1024.0;
+
+		printf("peak device memory:    %8.1f MiB\n", statistics.peakDeviceBytes / mebibyte);
+		for (const MemoryTypeUsage& type : statistics.memoryTypes)
+		{
+			printf("  type %2u heap %u:      %8.1f MiB (%.1f MiB used)%s%s\n", type.memoryTypeIndex, type.heapIndex,
+				type.peakAllocatedBytes / mebibyte, type.peakUsedBytes / mebibyte,
+				type.deviceLocal ? " device local" : "", type.hostVisible ? " host visible" : "");
+		}
+		printf("peak host memory:      %8.1f MiB\n", statistics.peakHostBytes / mebibyte);
+		printf("device local usage:    %8.1f MiB of %.1f MiB budget%s\n", statistics.deviceLocalUsage / mebibyte,
+			statistics.deviceLocalBudget / mebibyte, statistics.memoryBudget ? "" : " (heap size, VK_EXT_memory_budget not supported)");
+	}
+
 	return 0;
 }
@@ -0,0 +1,80 @@
+# compiles one entry point of a shader in lib/source/shaders to SPIR-V. OUTPUT ending in .h is written as a header
+# with a uint32_t array NAMESpirv, any other OUTPUT gets the binary module.
+# the shader files are raw string literals for the runtime compiler, the literal is stripped before compiling.
+# expects GLSLANG_VALIDATOR, SOURCE, STAGE (vert, frag, comp), ENTRY_POINT, NAME, OUTPUT and OPTIMIZATION:
+#   none         glslang without optimizer (-Od), the output the library shipped before spirv-opt was added
+#   size         glslang size passes (-Os)
+#   inline       spirv-opt inlining, dead branch and dead code elimination only
+#   performance  spirv-opt performance recipe (-O), loops with constant trip counts are unrolled
+# inline and performance need SPIRV_OPT
+get_filename_component(output_dir "${OUTPUT}" DIRECTORY)
+# per optimization, the variants of one shader are compiled in parallel
+set(glsl_path "${output_dir}/${NAME}.${OPTIMIZATION}.${STAGE}")
+set(spv_path "${output_dir}/${NAME}.${OPTIMIZATION}.tmp.spv")
+
+file(READ "${SOURCE}" glsl)
+string(REGEX REPLACE "^[ \t\r\n]*R\"\"\\(" "" glsl "${glsl}")
+string(REGEX REPLACE "\\)\"\"[ \t\r\n]*$" "" glsl "${glsl}")
+file(WRITE "${glsl_path}" "${glsl}")
+
+if(OPTIMIZATION STREQUAL "size")
+	set(glslang_optimization -Os)
+else()
+	set(glslang_optimization -Od)
+endif()
+
+if(OPTIMIZATION STREQUAL "inline")
+	set(opt_flags
+		--inline-entry-points-exhaustive --eliminate-dead-functions
+		--eliminate-local-single-block --eliminate-local-single-store
+		--eliminate-dead-branches --merge-return --merge-blocks
+		--eliminate-dead-code-aggressive)
+elseif(OPTIMIZATION STREQUAL "performance")
+	set(opt_flags -O)
+elseif(NOT OPTIMIZATION STREQUAL "none" AND NOT OPTIMIZATION STREQUAL "size")
+	message(FATAL_ERROR "Unknown shader optimization ${OPTIMIZATION}")
+endif()
+
+# same target and binding settings as ShaderCompiler::compile, but not the same optimization: glslang runs its size
+# passes for size (-Os) and no optimizer otherwise (-Od), spirv-opt runs separately below. the runtime compiler uses
+# glslang's in-process performance passes instead, so its output is not identical to any stage built here
+execute_process(
+	COMMAND "${GLSLANG_VALIDATOR}" -V --target-env vulkan1.0 -S ${STAGE}
+		-e ${ENTRY_POINT} --source-entrypoint ${ENTRY_POINT} --amb --aml ${glslang_optimization}
+		-o "${spv_path}" "${glsl_path}"
+	RESULT_VARIABLE result
+	OUTPUT_VARIABLE output
+	ERROR_VARIABLE output)
+
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "Failed to compile ${ENTRY_POINT} of ${SOURCE}:\n${output}")
+endif()
+
+if(opt_flags)
+	if(NOT SPIRV_OPT)
+		message(FATAL_ERROR "spirv-opt is required for ${OPTIMIZATION} shader optimization")
+	endif()
+
+	execute_process(
+		COMMAND "${SPIRV_OPT}" ${opt_flags} --target-env=vulkan1.0 "${spv_path}" -o "${spv_path}"
+		RESULT_VARIABLE result
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output)
+
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "Failed to optimize ${ENTRY_POINT} of ${SOURCE}:\n${output}")
+	endif()
+endif()
+
+if(OUTPUT MATCHES "\\.h$")
+	# SPIR-V words are stored little endian
+	file(READ "${spv_path}" spirv HEX)
+	string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " spirv "${spirv}")
+	# eight words per line, cmake regular expressions have no {n} repetition
+	set(word "0x........, ")
+	string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n\t" spirv "${spirv}")
+	file(WRITE "${OUTPUT}" "// generated by cmake/compile_shader.cmake from ${SOURCE}, ${OPTIMIZATION}\n#pragma once\n\nconst uint32_t ${NAME}Spirv[] = {\n\t${spirv}\n};\n")
+	file(REMOVE "${spv_path}")
+else()
+	file(RENAME "${spv_path}" "${OUTPUT}")
+endif()
@@ -1,5 +1,6 @@
 #pragma once
 #include "ResultType.h"
+#include <vector>
 
 namespace IBLLib
 {
@@ -17,5 +18,63 @@ namespace IBLLib
 		Charlie = 2
 	};
 
-	Result sample(const char* _inputPath, const char* _outputPathCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int  _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput);
+	// directory of the Vulkan pipeline cache, shared by all processes using it. the cache file is named after the GPU and
+	// driver, processes finishing at the same time merge their pipelines. nullptr restores the default:
+	// IBLSAMPLER_PIPELINE_CACHE_DIR if set, otherwise the user cache directory. an empty string disables the cache
+	void setPipelineCacheDirectory(const char* _directory);
+
+	// records CPU zones (file loading and writing, shader compilation, Vulkan setup) and the GPU passes of all sample
+	// calls until endTrace writes them to _path as chrome trace event JSON, viewable in Perfetto or chrome://tracing
+	void beginTrace();
+	Result endTrace(const char* _path);
+
+	// peak bytes of one Vulkan memory type during a sample call
+	struct MemoryTypeUsage
+	{
+		unsigned int memoryTypeIndex = 0u;
+		unsigned int heapIndex = 0u;
+		bool deviceLocal = false;
+		bool hostVisible = false;
+		unsigned long long peakAllocatedBytes = 0u; // VkDeviceMemory blocks
+		unsigned long long peakUsedBytes = 0u; // sub-allocated to images and buffers
+	};
+
+	// milliseconds spent in the stages of one sample call. the GPU passes (panoramaToCubeMap to formatConversion) are
+	// measured with timestamp queries, without queue support for them they are the wall clock time of one blocking
+	// submission each. all other stages are CPU wall clock time
+	struct Statistics
+	{
+		double initialize = 0.0; // Vulkan instance, device and pipeline cache
+		double decode = 0.0; // reading the input file, radiance files are decoded while uploading
+		double upload = 0.0; // until the last chunk is submitted, the copies may finish during execute
+		double panoramaToCubeMap = 0.0;
+		double mipGeneration = 0.0;
+		double filter = 0.0; // sum of filterMips
+		std::vector<double> filterMips; // indexed by output mip level
+		double formatConversion = 0.0;
+		double execute = 0.0; // recording, submitting and waiting for all GPU passes
+		double readback = 0.0;
+		double write = 0.0; // encoding and writing the output files
+		double total = 0.0;
+		bool gpuTimestamps = false; // the GPU passes were timed with timestamp queries
+
+		// memory high-water marks of the call
+		unsigned long long peakDeviceBytes = 0u; // VkDeviceMemory allocated by the sampler
+		unsigned long long peakHostBytes = 0u; // decoded input, read back and encoded images
+		std::vector<MemoryTypeUsage> memoryTypes; // only the memory types that were allocated from
+		// device local heaps once the GPU passes executed, from VK_EXT_memory_budget if memoryBudget is set. otherwise the
+		// budget is the heap size and the usage only counts the sampler's own allocations
+		unsigned long long deviceLocalBudget = 0u;
+		unsigned long long deviceLocalUsage = 0u;
+		bool memoryBudget = false;
+	};
+
+	// _outStatistics is filled if sample succeeds
+	Result sample(const char* _inputPath, const char* _outputPathCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int  _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput, Statistics* _outStatistics = nullptr);
+
+	// filters environments of the same kind (panoramas or cube maps), format and resolution together. they are packed into
+	// the layers of cube map arrays and every stage runs once for all of them. _outputPathsCubeMap holds one path per input,
+	// or a single path for a KTX2 cube map array with one layer per input. the LUT is written once. the statistics cover
+	// the whole batch
+	Result sampleArray(const std::vector<const char*>& _inputPaths, const std::vector<const char*>& _outputPathsCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput, Statistics* _outStatistics = nullptr);
 } // !IBLLib
\ No newline at end of file
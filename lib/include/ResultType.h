@@ -12,6 +12,8 @@ namespace IBLLib
 		FileNotFound,
 		InvalidArgument,
 		KtxError,
-		StbError
+		StbError,
+		HdrError,
+		ExrError
 	};
 } // !IBLLib
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "ExrReader.h"
+#include "PixelConversion.h"
+#include "FileHelper.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
+
+// chunks are decompressed on std::threads inside LoadEXRImageFromMemory
+#define TINYEXR_USE_THREAD 1
+#define TINYEXR_USE_OPENMP 0
+#define TINYEXR_IMPLEMENTATION
+#include <tinyexr.h>
+
+namespace
+{
+	const char* const g_ChannelNames[4] = { "R", "G", "B", "A" };
+
+	constexpr uint16_t g_HalfOne = 0x3c00u;
+
+	void printExrError(const char* _path, const char* _error)
+	{
+		printf("Failed to load OpenEXR image %s\n", _path);
+
+		if (_error != nullptr)
+		{
+			printf("tinyexr: %s\n", _error);
+			FreeEXRErrorMessage(_error);
+		}
+	}
+}
+
+struct IBLLib::ExrReader::Image
+{
+	Image()
+	{
+		InitEXRHeader(&header);
+		InitEXRImage(&image);
+	}
+
+	~Image()
+	{
+		FreeEXRImage(&image);
+		FreeEXRHeader(&header);
+	}
+
+	EXRHeader header;
+	EXRImage image;
+
+	// R, G, B, A planes, alpha may be missing
+	const uint8_t* planes[4] = {};
+	bool isHalf[4] = {};
+};
+
+IBLLib::ExrReader::ExrReader() = default;
+
+IBLLib::ExrReader::~ExrReader() = default;
+
+bool IBLLib::ExrReader::isExrFile(const char* _path)
+{
+	return IsEXR(_path) == TINYEXR_SUCCESS;
+}
+
+IBLLib::Result IBLLib::ExrReader::load(const char* _path)
+{
+	TraceZone zone("ExrReader::load");
+
+	if (m_image != nullptr)
+	{
+		return InvalidArgument;
+	}
+
+	// tinyexr would read the whole file into a heap buffer first
+	MappedFile file;
+	if (file.open(_path) == false)
+	{
+		return FileNotFound;
+	}
+
+	EXRVersion version{};
+	if (ParseEXRVersionFromMemory(&version, file.getData(), file.getSize()) != TINYEXR_SUCCESS)
+	{
+		printExrError(_path, nullptr);
+		return ExrError;
+	}
+
+	if (version.tiled || version.multipart || version.non_image)
+	{
+		printf("Unsupported OpenEXR image %s (tiled, multipart or deep)\n", _path);
+		return ExrError;
+	}
+
+	std::unique_ptr<Image> image(new Image());
+	const char* error = nullptr;
+
+	if (ParseEXRHeaderFromMemory(&image->header, &version, file.getData(), file.getSize(), &error) != TINYEXR_SUCCESS)
+	{
+		printExrError(_path, error);
+		return ExrError;
+	}
+
+	int channelIndices[4] = { -1, -1, -1, -1 };
+
+	for (int i = 0; i < image->header.num_channels; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			if (strcmp(image->header.channels[i].name, g_ChannelNames[c]) == 0)
+			{
+				channelIndices[c] = i;
+			}
+		}
+
+		// keep half as half instead of the default float expansion
+		image->header.requested_pixel_types[i] = image->header.pixel_types[i];
+	}
+
+	for (int c = 0; c < 4; ++c)
+	{
+		const int index = channelIndices[c];
+
+		if (index < 0)
+		{
+			if (c < 3)
+			{
+				printf("OpenEXR image %s has no %s channel\n", _path, g_ChannelNames[c]);
+				return ExrError;
+			}
+			continue;
+		}
+
+		const int pixelType = image->header.pixel_types[index];
+		if (pixelType != TINYEXR_PIXELTYPE_HALF && pixelType != TINYEXR_PIXELTYPE_FLOAT)
+		{
+			printf("OpenEXR image %s: unsupported pixel type of channel %s\n", _path, g_ChannelNames[c]);
+			return ExrError;
+		}
+	}
+
+	if (LoadEXRImageFromMemory(&image->image, &image->header, file.getData(), file.getSize(), &error) != TINYEXR_SUCCESS)
+	{
+		printExrError(_path, error);
+		return ExrError;
+	}
+
+	for (int c = 0; c < 4; ++c)
+	{
+		const int index = channelIndices[c];
+		if (index >= 0)
+		{
+			image->planes[c] = image->image.images[index];
+			image->isHalf[c] = image->header.requested_pixel_types[index] == TINYEXR_PIXELTYPE_HALF;
+		}
+	}
+
+	m_width = static_cast<uint32_t>(image->image.width);
+	m_height = static_cast<uint32_t>(image->image.height);
+
+	// tinyexr keeps every channel of the file, not only R, G, B and A
+	m_byteSize = 0u;
+	for (int i = 0; i < image->header.num_channels; ++i)
+	{
+		const size_t channelSize = image->header.requested_pixel_types[i] == TINYEXR_PIXELTYPE_HALF ? 2u : 4u;
+		m_byteSize += static_cast<size_t>(m_width) * m_height * channelSize;
+	}
+	m_image = std::move(image);
+
+	printf("Successfully loaded %s %u x %u\n", _path, m_width, m_height);
+
+	return Success;
+}
+
+void IBLLib::ExrReader::release()
+{
+	m_image.reset();
+	m_width = 0u;
+	m_height = 0u;
+	m_byteSize = 0u;
+}
+
+IBLLib::Result IBLLib::ExrReader::readRows(uint32_t _firstRow, uint32_t _rowCount, uint16_t* _outRGBA, ThreadPool& _pool) const
+{
+	TraceZone zone("ExrReader::readRows");
+
+	if (m_image == nullptr || _firstRow > m_height || _rowCount > m_height - _firstRow)
+	{
+		return InvalidArgument;
+	}
+
+	const Image& image = *m_image;
+	const size_t width = m_width;
+	const uint32_t taskCount = std::min(_rowCount, 4u * _pool.getThreadCount());
+
+	_pool.parallelFor(taskCount, [&](uint32_t _task)
+	{
+		const uint32_t firstRow = static_cast<uint32_t>(static_cast<uint64_t>(_rowCount) * _task / taskCount);
+		const uint32_t endRow = static_cast<uint32_t>(static_cast<uint64_t>(_rowCount) * (_task + 1u) / taskCount);
+
+		for (uint32_t row = firstRow; row < endRow; ++row)
+		{
+			const size_t srcOffset = (_firstRow + row) * width;
+			uint16_t* pDst = _outRGBA + row * width * 4u;
+
+			for (uint32_t c = 0u; c < 4u; ++c)
+			{
+				if (image.planes[c] == nullptr)
+				{
+					for (size_t x = 0u; x < width; ++x)
+					{
+						pDst[4u * x + c] = g_HalfOne;
+					}
+				}
+				else if (image.isHalf[c])
+				{
+					const uint16_t* pSrc = reinterpret_cast<const uint16_t*>(image.planes[c]) + srcOffset;
+					for (size_t x = 0u; x < width; ++x)
+					{
+						pDst[4u * x + c] = pSrc[x];
+					}
+				}
+				else
+				{
+					const float* pSrc = reinterpret_cast<const float*>(image.planes[c]) + srcOffset;
+					for (size_t x = 0u; x < width; ++x)
+					{
+						pDst[4u * x + c] = floatToHalf(pSrc[x]);
+					}
+				}
+			}
+		}
+	});
+
+	return Success;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ResultType.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <stdint.h>
+
+namespace IBLLib
+{
+	// OpenEXR scanline images through tinyexr. compressed chunks (PIZ, ZIP, ...) are decoded on multiple threads
+	// and half channels are kept as half, float channels are narrowed to half while interleaving
+	class ExrReader
+	{
+	public:
+		ExrReader();
+		~ExrReader();
+
+		ExrReader(const ExrReader&) = delete;
+		ExrReader& operator=(const ExrReader&) = delete;
+
+		// checks the magic number without decoding
+		static bool isExrFile(const char* _path);
+
+		// needs R, G and B channels (A is optional), tiled and multipart files are not supported
+		Result load(const char* _path);
+		void release();
+
+		uint32_t getWidth() const { return m_width; }
+		uint32_t getHeight() const { return m_height; }
+		// decoded channel planes held until release
+		size_t getByteSize() const { return m_byteSize; }
+
+		// interleaves _rowCount rows starting at _firstRow as R16G16B16A16_SFLOAT (alpha = 1 if missing)
+		Result readRows(uint32_t _firstRow, uint32_t _rowCount, uint16_t* _outRGBA, ThreadPool& _pool) const;
+
+	private:
+		struct Image;
+		std::unique_ptr<Image> m_image;
+
+		uint32_t m_width = 0u;
+		uint32_t m_height = 0u;
+		size_t m_byteSize = 0u;
+	};
+} // !IBLLib
@@ -1,6 +1,19 @@
 #include "FileHelper.h"
 #include <stdio.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool IBLLib::readFile(const char* _path, std::vector<char>& _outBuffer)
 {
 	FILE* file = fopen(_path, "rb");
@@ -41,3 +54,251 @@ bool IBLLib::writeFile(const char* _path, const char* _data, size_t _bytes)
 
 	return sizeWritten > 0u;
 }
+
+bool IBLLib::writeFileAtomic(const char* _path, const char* _data, size_t _bytes)
+{
+	// unique per process, concurrent writers never share a temporary file
+#ifdef _WIN32
+	const std::string tempPath = std::string(_path) + ".tmp" + std::to_string(GetCurrentProcessId());
+#else
+	const std::string tempPath = std::string(_path) + ".tmp" + std::to_string(getpid());
+#endif
+
+	FILE* file = fopen(tempPath.c_str(), "wb");
+
+	if (file == nullptr)
+	{
+		printf("Failed to open file %s\n", tempPath.c_str());
+		return false;
+	}
+
+	const size_t sizeWritten = fwrite(_data, sizeof(char), _bytes, file);
+	const bool flushed = fflush(file) == 0;
+	fclose(file);
+
+	bool renamed = false;
+	if (sizeWritten == _bytes && flushed)
+	{
+#ifdef _WIN32
+		renamed = MoveFileExA(tempPath.c_str(), _path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		renamed = rename(tempPath.c_str(), _path) == 0;
+#endif
+	}
+
+	if (renamed == false)
+	{
+		printf("Failed to write file %s\n", _path);
+		remove(tempPath.c_str());
+	}
+
+	return renamed;
+}
+
+bool IBLLib::createDirectories(const std::string& _path)
+{
+	if (_path.empty())
+	{
+		return false;
+	}
+
+	// create every prefix ending at a separator, then the full path
+	for (size_t i = 1u; i <= _path.size(); ++i)
+	{
+		if (i != _path.size() && _path[i] != '/' && _path[i] != '\\')
+		{
+			continue;
+		}
+
+		const std::string directory = _path.substr(0u, i);
+#ifdef _WIN32
+		if (CreateDirectoryA(directory.c_str(), nullptr) == 0 && GetLastError() != ERROR_ALREADY_EXISTS)
+#else
+		if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+#endif
+		{
+			printf("Failed to create directory %s\n", directory.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+IBLLib::FileLock::~FileLock()
+{
+	unlock();
+}
+
+bool IBLLib::FileLock::lock(const char* _path, bool _shared)
+{
+	unlock();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		printf("Failed to open lock file %s\n", _path);
+		return false;
+	}
+
+	OVERLAPPED overlapped{};
+	if (LockFileEx(file, _shared ? 0u : LOCKFILE_EXCLUSIVE_LOCK, 0u, 1u, 0u, &overlapped) == 0)
+	{
+		printf("Failed to lock %s\n", _path);
+		CloseHandle(file);
+		return false;
+	}
+#else
+	const int file = ::open(_path, O_RDWR | O_CREAT, 0666);
+
+	if (file < 0)
+	{
+		printf("Failed to open lock file %s\n", _path);
+		return false;
+	}
+
+	int res = 0;
+	while ((res = flock(file, _shared ? LOCK_SH : LOCK_EX)) != 0 && errno == EINTR) {}
+
+	if (res != 0)
+	{
+		printf("Failed to lock %s\n", _path);
+		::close(file);
+		return false;
+	}
+#endif
+
+	m_file = file;
+	return true;
+}
+
+void IBLLib::FileLock::unlock()
+{
+#ifdef _WIN32
+	if (m_file != nullptr)
+	{
+		OVERLAPPED overlapped{};
+		UnlockFileEx(m_file, 0u, 1u, 0u, &overlapped);
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+#else
+	if (m_file >= 0)
+	{
+		flock(m_file, LOCK_UN);
+		::close(m_file);
+		m_file = -1;
+	}
+#endif
+}
+
+IBLLib::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool IBLLib::MappedFile::open(const char* _path, bool _sequential)
+{
+	if (m_data != nullptr)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	// other processes may delete or rename over the file while it is open
+	HANDLE file = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		_sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		printf("Failed to open file %s\n", _path);
+		return false;
+	}
+
+	LARGE_INTEGER size{};
+	HANDLE mapping = nullptr;
+
+	// empty files can not be mapped
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0u, 0u, nullptr);
+	}
+
+	// the mapping keeps the file open
+	CloseHandle(file);
+
+	if (mapping == nullptr)
+	{
+		printf("Failed to map file %s\n", _path);
+		return false;
+	}
+
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0u, 0u, 0u);
+	if (data == nullptr)
+	{
+		printf("Failed to map file %s\n", _path);
+		CloseHandle(mapping);
+		return false;
+	}
+
+	m_mapping = mapping;
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const int file = ::open(_path, O_RDONLY);
+
+	if (file < 0)
+	{
+		printf("Failed to open file %s\n", _path);
+		return false;
+	}
+
+	struct stat info{};
+	void* data = MAP_FAILED;
+
+	// empty files can not be mapped
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+	{
+		data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	}
+
+	// the mapping keeps the file open
+	::close(file);
+
+	if (data == MAP_FAILED)
+	{
+		printf("Failed to map file %s\n", _path);
+		return false;
+	}
+
+	if (_sequential)
+	{
+		madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+	}
+
+	m_size = static_cast<size_t>(info.st_size);
+#endif
+
+	m_data = static_cast<const uint8_t*>(data);
+	return true;
+}
+
+void IBLLib::MappedFile::close()
+{
+	if (m_data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0u;
+}
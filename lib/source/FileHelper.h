@@ -1,12 +1,74 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
 #include <vector>
 
 namespace IBLLib
 {
 	bool readFile(const char* _path, std::vector<char>& _outBuffer);
 
+	// read only view of a whole file backed by the page cache. nothing is copied into the process,
+	// jobs that map the same file share the cached pages
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// _sequential lets the kernel read ahead aggressively and drop pages behind the read position early
+		bool open(const char* _path, bool _sequential = true);
+		void close();
+
+		bool isOpen() const { return m_data != nullptr; }
+
+		const uint8_t* getData() const { return m_data; }
+		size_t getSize() const { return m_size; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0u;
+
+#ifdef _WIN32
+		void* m_mapping = nullptr;
+#endif
+	};
+
+	// advisory lock on the file _path (created if missing), held until unlock or destruction.
+	// serializes processes that update the same file, the locked file itself stays empty
+	class FileLock
+	{
+	public:
+		FileLock() = default;
+		~FileLock();
+
+		FileLock(const FileLock&) = delete;
+		FileLock& operator=(const FileLock&) = delete;
+
+		// blocks until no other process holds the lock exclusively. shared locks only exclude exclusive ones, readers
+		// take them to keep a writer from replacing the file while it is open (Windows can not rename over mapped files)
+		bool lock(const char* _path, bool _shared = false);
+		void unlock();
+
+	private:
+#ifdef _WIN32
+		void* m_file = nullptr;
+#else
+		int m_file = -1;
+#endif
+	};
+
 	bool writeFile(const char* _path, const char* _data, size_t _bytes);
 
+	// writes a temporary file next to _path and renames it over _path, readers see either the old or the new file
+	bool writeFileAtomic(const char* _path, const char* _data, size_t _bytes);
+
+	// creates _path and missing parent directories, true if the directory exists afterwards
+	bool createDirectories(const std::string& _path);
+
 	template <class T>
 	bool writeFile(const char* _path, const std::vector<T>& _outBuffer)
 	{
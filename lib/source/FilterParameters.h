@@ -0,0 +1,18 @@
+#pragma once
+#include "GltfIblSampler.h"
+#include <stdint.h>
+
+namespace IBLLib
+{
+	// push constants of the filter pass, same layout as FilterParameters in shaders/filter.frag
+	struct FilterParameters
+	{
+		float roughness = 0.f;
+		uint32_t sampleCount = 1u;
+		uint32_t mipLevel = 1u;
+		uint32_t width = 1024u;
+		float lodBias = 0.f;
+		Distribution distribution = Distribution::Lambertian;
+		uint32_t writeLUT = 1u;
+	};
+} // !IBLLib
@@ -0,0 +1,326 @@
+#include "HdrReader.h"
+#include "PixelConversion.h"
+#include "Trace.h"
+#include "format.h"
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
+
+namespace
+{
+	// scanlines outside of this range are never run length encoded
+	constexpr uint32_t g_MinRleWidth = 8u;
+	constexpr uint32_t g_MaxRleWidth = 0x7fffu;
+}
+
+IBLLib::HdrReader::~HdrReader()
+{
+	close();
+}
+
+IBLLib::Result IBLLib::HdrReader::open(const char* _path)
+{
+	TraceZone zone("HdrReader::open");
+
+	if (m_file.isOpen())
+	{
+		return InvalidArgument;
+	}
+
+	if (m_file.open(_path) == false)
+	{
+		return FileNotFound;
+	}
+
+	m_readPos = 0u;
+
+	char line[256];
+	if (readLine(line, sizeof(line)) == false || (strcmp(line, "#?RADIANCE") != 0 && strcmp(line, "#?RGBE") != 0))
+	{
+		close();
+		return HdrError;
+	}
+
+	bool validFormat = false;
+	while (readLine(line, sizeof(line)) && line[0] != '\0')
+	{
+		if (strcmp(line, "FORMAT=32-bit_rle_rgbe") == 0)
+		{
+			validFormat = true;
+		}
+	}
+
+	int height = 0;
+	int width = 0;
+	if (validFormat == false || readLine(line, sizeof(line)) == false || sscanf(line, "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+	{
+		printf("Unsupported Radiance header in %s\n", _path);
+		close();
+		return HdrError;
+	}
+
+	m_width = static_cast<uint32_t>(width);
+	m_height = static_cast<uint32_t>(height);
+	m_currentRow = 0u;
+	m_rowBuffer.resize(static_cast<size_t>(m_width) * 4u);
+
+	printf("Opened %s %u x %u\n", _path, m_width, m_height);
+
+	return Success;
+}
+
+void IBLLib::HdrReader::close()
+{
+	m_file.close();
+	m_rowBuffer.clear();
+	m_rowBuffer.shrink_to_fit();
+	m_rowOffsets.clear();
+	m_readPos = 0u;
+}
+
+IBLLib::Result IBLLib::HdrReader::readScanlines(uint32_t _rowCount, uint8_t* _outRGBE)
+{
+	const Result res = scanScanlines(_rowCount);
+	if (res != Success)
+	{
+		return res;
+	}
+
+	const size_t rowPitch = static_cast<size_t>(m_width) * 4u;
+
+	for (uint32_t row = 0u; row < _rowCount; ++row)
+	{
+		decodeScanline(m_file.getData() + m_rowOffsets[row], _outRGBE + row * rowPitch);
+	}
+
+	return Success;
+}
+
+IBLLib::Result IBLLib::HdrReader::readScanlines(uint32_t _rowCount, float* _outRGBA)
+{
+	const size_t rowPitch = static_cast<size_t>(m_width) * 4u;
+
+	for (uint32_t row = 0u; row < _rowCount; ++row)
+	{
+		const Result res = readScanlines(1u, m_rowBuffer.data());
+		if (res != Success)
+		{
+			return res;
+		}
+
+		rgbeToFloat(m_rowBuffer.data(), _outRGBA + row * rowPitch, m_width);
+	}
+
+	return Success;
+}
+
+IBLLib::Result IBLLib::HdrReader::readScanlines(uint32_t _rowCount, void* _out, VkFormat _format, ThreadPool& _pool)
+{
+	TraceZone zone("HdrReader::readScanlines");
+
+	const size_t dstRowPitch = static_cast<size_t>(m_width) * getFormatSize(_format);
+	if (dstRowPitch == 0u)
+	{
+		return InvalidArgument;
+	}
+
+	const Result res = scanScanlines(_rowCount);
+	if (res != Success)
+	{
+		return res;
+	}
+
+	// a few tasks per thread to even out rows that compress differently
+	const uint32_t taskCount = std::min(_rowCount, 4u * _pool.getThreadCount());
+	std::atomic<bool> failed(false);
+
+	_pool.parallelFor(taskCount, [&](uint32_t _task)
+	{
+		const uint32_t firstRow = static_cast<uint32_t>(static_cast<uint64_t>(_rowCount) * _task / taskCount);
+		const uint32_t endRow = static_cast<uint32_t>(static_cast<uint64_t>(_rowCount) * (_task + 1u) / taskCount);
+
+		// R8G8B8A8_UINT keeps the RGBE texels for decoding on the GPU
+		const bool raw = _format == VK_FORMAT_R8G8B8A8_UINT;
+		std::vector<uint8_t> rgbe(raw ? 0u : static_cast<size_t>(m_width) * 4u);
+
+		for (uint32_t row = firstRow; row < endRow; ++row)
+		{
+			uint8_t* pDst = static_cast<uint8_t*>(_out) + row * dstRowPitch;
+
+			if (raw)
+			{
+				decodeScanline(m_file.getData() + m_rowOffsets[row], pDst);
+				continue;
+			}
+
+			decodeScanline(m_file.getData() + m_rowOffsets[row], rgbe.data());
+
+			if (convertRGBE(rgbe.data(), pDst, m_width, _format) == false)
+			{
+				failed = true;
+				return;
+			}
+		}
+	});
+
+	return failed ? InvalidArgument : Success;
+}
+
+bool IBLLib::HdrReader::readByte(uint8_t& _outByte)
+{
+	if (m_readPos == m_file.getSize())
+	{
+		return false;
+	}
+
+	_outByte = m_file.getData()[m_readPos++];
+	return true;
+}
+
+bool IBLLib::HdrReader::skipBytes(size_t _count)
+{
+	if (_count > m_file.getSize() - m_readPos)
+	{
+		return false;
+	}
+
+	m_readPos += _count;
+	return true;
+}
+
+bool IBLLib::HdrReader::readLine(char* _outLine, size_t _capacity)
+{
+	size_t length = 0u;
+	uint8_t c = 0u;
+
+	while (readByte(c) && c != '\n')
+	{
+		if (length + 1u < _capacity)
+		{
+			_outLine[length++] = static_cast<char>(c);
+		}
+	}
+
+	_outLine[length] = '\0';
+	return c == '\n';
+}
+
+IBLLib::Result IBLLib::HdrReader::scanScanlines(uint32_t _rowCount)
+{
+	if (m_file.isOpen() == false || _rowCount > m_height - m_currentRow)
+	{
+		return InvalidArgument;
+	}
+
+	m_rowOffsets.resize(_rowCount + 1u);
+
+	for (uint32_t row = 0u; row < _rowCount; ++row)
+	{
+		m_rowOffsets[row] = m_readPos;
+
+		if (scanScanline() == false)
+		{
+			printf("Failed to decode scanline %u\n", m_currentRow);
+			return HdrError;
+		}
+
+		++m_currentRow;
+	}
+
+	m_rowOffsets[_rowCount] = m_readPos;
+
+	return Success;
+}
+
+bool IBLLib::HdrReader::scanScanline()
+{
+	const size_t rowPitch = static_cast<size_t>(m_width) * 4u;
+
+	if (m_width < g_MinRleWidth || m_width > g_MaxRleWidth || m_file.getSize() - m_readPos < 4u)
+	{
+		return skipBytes(rowPitch);
+	}
+
+	const uint8_t* header = m_file.getData() + m_readPos;
+
+	// not run length encoded, the header already is the first texel
+	if (header[0] != 2u || header[1] != 2u || (header[2] & 0x80u) != 0u)
+	{
+		return skipBytes(rowPitch);
+	}
+
+	if (((static_cast<uint32_t>(header[2]) << 8) | header[3]) != m_width)
+	{
+		return false;
+	}
+
+	m_readPos += 4u;
+
+	// the four channels are encoded one after another, only the counts are looked at here
+	for (uint32_t channel = 0u; channel < 4u; ++channel)
+	{
+		uint32_t x = 0u;
+		while (x < m_width)
+		{
+			uint8_t count = 0u;
+			if (readByte(count) == false)
+			{
+				return false;
+			}
+
+			// run of one value or dump of count values
+			const bool run = count > 128u;
+			const uint32_t length = run ? count - 128u : count;
+
+			if (length == 0u || length > m_width - x || skipBytes(run ? 1u : length) == false)
+			{
+				return false;
+			}
+
+			x += length;
+		}
+	}
+
+	return true;
+}
+
+void IBLLib::HdrReader::decodeScanline(const uint8_t* _encoded, uint8_t* _outRGBE) const
+{
+	const size_t rowPitch = static_cast<size_t>(m_width) * 4u;
+
+	// same decision as scanScanline, the structure was already validated there
+	if (m_width < g_MinRleWidth || m_width > g_MaxRleWidth ||
+		_encoded[0] != 2u || _encoded[1] != 2u || (_encoded[2] & 0x80u) != 0u)
+	{
+		memcpy(_outRGBE, _encoded, rowPitch);
+		return;
+	}
+
+	const uint8_t* pSrc = _encoded + 4u;
+
+	for (uint32_t channel = 0u; channel < 4u; ++channel)
+	{
+		uint8_t* pDst = _outRGBE + channel;
+		const uint8_t* pEnd = pDst + rowPitch;
+
+		while (pDst < pEnd)
+		{
+			uint32_t count = *pSrc++;
+			if (count > 128u)
+			{
+				const uint8_t value = *pSrc++;
+				for (count -= 128u; count > 0u; --count, pDst += 4u)
+				{
+					*pDst = value;
+				}
+			}
+			else
+			{
+				for (; count > 0u; --count, pDst += 4u)
+				{
+					*pDst = *pSrc++;
+				}
+			}
+		}
+	}
+}
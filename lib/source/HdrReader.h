@@ -0,0 +1,68 @@
+#pragma once
+#include "ResultType.h"
+#include "ThreadPool.h"
+#include "FileHelper.h"
+#include <stdint.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace IBLLib
+{
+	// streaming reader for Radiance .hdr (RGBE) files. the file is mapped and scanlines are decoded straight from
+	// the mapping, so only the rows currently requested are expanded instead of the whole image.
+	// reading is split in a sequential scan of the RLE structure that finds where each scanline starts, and the
+	// expansion and conversion of the scanlines which runs in parallel
+	class HdrReader
+	{
+	public:
+		HdrReader() = default;
+		~HdrReader();
+
+		HdrReader(const HdrReader&) = delete;
+		HdrReader& operator=(const HdrReader&) = delete;
+
+		// parses the header, fails for files that are not Radiance images (only -Y h +X w orientation is supported)
+		Result open(const char* _path);
+		void close();
+
+		// decodes the next _rowCount scanlines into _outRGBE (4 bytes per texel, no padding between rows)
+		Result readScanlines(uint32_t _rowCount, uint8_t* _outRGBE);
+
+		// decodes the next _rowCount scanlines as RGBA32F (alpha = 1), uses an internal row buffer
+		Result readScanlines(uint32_t _rowCount, float* _outRGBA);
+
+		// decodes the next _rowCount scanlines on _pool and converts them to _format (see convertRGBA32F) in _out.
+		// R8G8B8A8_UINT returns the expanded RGBE texels
+		Result readScanlines(uint32_t _rowCount, void* _out, VkFormat _format, ThreadPool& _pool);
+
+		uint32_t getWidth() const { return m_width; }
+		uint32_t getHeight() const { return m_height; }
+
+		// first row returned by the next readScanlines call
+		uint32_t getCurrentRow() const { return m_currentRow; }
+
+	private:
+		bool readByte(uint8_t& _outByte);
+		bool skipBytes(size_t _count);
+		bool readLine(char* _outLine, size_t _capacity);
+
+		// skips the encoded bytes of the next scanline and checks the run lengths
+		bool scanScanline();
+
+		// scans _rowCount scanlines, m_rowOffsets[i] .. m_rowOffsets[i + 1] are the bytes of row i in the file
+		Result scanScanlines(uint32_t _rowCount);
+
+		void decodeScanline(const uint8_t* _encoded, uint8_t* _outRGBE) const;
+
+		MappedFile m_file;
+		size_t m_readPos = 0u;
+
+		std::vector<size_t> m_rowOffsets; // scanlines of the current readScanlines call
+		std::vector<uint8_t> m_rowBuffer; // one RGBE row for the float overload
+
+		uint32_t m_width = 0u;
+		uint32_t m_height = 0u;
+		uint32_t m_currentRow = 0u;
+	};
+} // !IBLLib
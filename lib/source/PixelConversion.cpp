@@ -0,0 +1,349 @@
+#include "PixelConversion.h"
+#include "format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IBLSAMPLER_SSE2 1
+#include <emmintrin.h>
+#else
+#define IBLSAMPLER_SSE2 0
+#endif
+
+#if defined(__AVX2__)
+#define IBLSAMPLER_AVX2 1
+#include <immintrin.h>
+#else
+#define IBLSAMPLER_AVX2 0
+#endif
+
+namespace
+{
+	constexpr uint32_t g_HalfMaxBits = 0x477fe000u; // 65504.0f
+	constexpr uint32_t g_HalfMinNormalBits = 113u << 23; // 2^-14
+	constexpr uint32_t g_HalfDenormMagicBits = 126u << 23; // 0.5f, shifts denormals into the low mantissa bits
+
+	// (2^9 - 1) / 2^9 * 2^(31 - 15)
+	constexpr float g_SharedExpMax = 65408.0f;
+
+	inline uint32_t asUint(float _value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &_value, sizeof(bits));
+		return bits;
+	}
+
+	inline float asFloat(uint32_t _bits)
+	{
+		float value;
+		memcpy(&value, &_bits, sizeof(value));
+		return value;
+	}
+
+	inline float clampSharedExp(float _value)
+	{
+		// written so that NaN ends up as 0
+		return _value > 0.0f ? std::min(_value, g_SharedExpMax) : 0.0f;
+	}
+
+	inline uint32_t roundScaled(float _value, float _scale)
+	{
+		return static_cast<uint32_t>(_value * _scale + 0.5f);
+	}
+
+	// texels converted per step of convertRGBE
+	constexpr size_t g_RGBEBlockSize = 256u;
+
+#if IBLSAMPLER_AVX2
+	// 2^(e - 136) is split into two normal factors 2^((e >> 1) - 68) * 2^(e - (e >> 1) - 68) so that small exponents
+	// round once to the same denormal as ldexp does
+	inline __m256 rgbeToFloatAVX2(__m256i _rgbe)
+	{
+		const __m256i exponent = _mm256_shuffle_epi32(_rgbe, 0xff);
+		const __m256i exponentLo = _mm256_srli_epi32(exponent, 1);
+		const __m256i exponentHi = _mm256_sub_epi32(exponent, exponentLo);
+
+		const __m256i bias = _mm256_set1_epi32(127 - 68);
+		const __m256 scaleLo = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(exponentLo, bias), 23));
+		const __m256 scaleHi = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(exponentHi, bias), 23));
+
+		__m256 value = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_rgbe), scaleLo), scaleHi);
+		value = _mm256_and_ps(value, _mm256_castsi256_ps(_mm256_cmpgt_epi32(exponent, _mm256_setzero_si256())));
+
+		return _mm256_blend_ps(value, _mm256_set1_ps(1.0f), 0x88);
+	}
+#elif IBLSAMPLER_SSE2
+	// see rgbeToFloatAVX2
+	inline __m128 rgbeToFloatSSE2(__m128i _rgbe)
+	{
+		const __m128i exponent = _mm_shuffle_epi32(_rgbe, 0xff);
+		const __m128i exponentLo = _mm_srli_epi32(exponent, 1);
+		const __m128i exponentHi = _mm_sub_epi32(exponent, exponentLo);
+
+		const __m128i bias = _mm_set1_epi32(127 - 68);
+		const __m128 scaleLo = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponentLo, bias), 23));
+		const __m128 scaleHi = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponentHi, bias), 23));
+
+		__m128 value = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_rgbe), scaleLo), scaleHi);
+		value = _mm_and_ps(value, _mm_castsi128_ps(_mm_cmpgt_epi32(exponent, _mm_setzero_si128())));
+
+		const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		return _mm_or_ps(_mm_and_ps(value, rgbMask), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+	}
+#endif
+
+#if IBLSAMPLER_SSE2
+	// 4 floats to 4 halfs in the low 16 bits of each lane, same rounding and clamping as floatToHalf
+	inline __m128i floatToHalfSSE2(__m128 _value)
+	{
+		const __m128i bits = _mm_castps_si128(_value);
+		const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+
+		// min returns the second operand for NaN
+		const __m128 absValue = _mm_min_ps(_mm_castsi128_ps(_mm_xor_si128(bits, sign)), _mm_castsi128_ps(_mm_set1_epi32(g_HalfMaxBits)));
+		const __m128i absBits = _mm_castps_si128(absValue);
+
+		const __m128i magic = _mm_set1_epi32(g_HalfDenormMagicBits);
+		const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absValue, _mm_castsi128_ps(magic))), magic);
+
+		const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(absBits, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(absBits, _mm_set1_epi32(static_cast<int>((15u - 127u) << 23) + 0xfff));
+		normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissaOdd), 13);
+
+		const __m128i isDenormal = _mm_cmplt_epi32(absBits, _mm_set1_epi32(g_HalfMinNormalBits));
+		const __m128i half = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+
+		return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+	}
+
+	void convertToHalfSSE2(const float* _src, uint16_t* _dst, size_t _floatCount)
+	{
+		size_t i = 0u;
+		for (; i + 8u <= _floatCount; i += 8u)
+		{
+			const __m128i lo = floatToHalfSSE2(_mm_loadu_ps(_src + i));
+			const __m128i hi = floatToHalfSSE2(_mm_loadu_ps(_src + i + 4u));
+
+			// sign extend so the saturating pack keeps all 16 bits
+			const __m128i packed = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+				_mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), packed);
+		}
+
+		for (; i < _floatCount; ++i)
+		{
+			_dst[i] = IBLLib::floatToHalf(_src[i]);
+		}
+	}
+
+	void convertToE5B9G9R9SSE2(const float* _src, uint32_t* _dst, size_t _texelCount)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxValue = _mm_set1_ps(g_SharedExpMax);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128i exponentMask = _mm_set1_epi32(0xff);
+
+		size_t i = 0u;
+		for (; i + 4u <= _texelCount; i += 4u)
+		{
+			__m128 r = _mm_loadu_ps(_src + 4u * i);
+			__m128 g = _mm_loadu_ps(_src + 4u * i + 4u);
+			__m128 b = _mm_loadu_ps(_src + 4u * i + 8u);
+			__m128 a = _mm_loadu_ps(_src + 4u * i + 12u);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+
+			// max returns the second operand for NaN
+			r = _mm_min_ps(_mm_max_ps(r, zero), maxValue);
+			g = _mm_min_ps(_mm_max_ps(g, zero), maxValue);
+			b = _mm_min_ps(_mm_max_ps(b, zero), maxValue);
+
+			const __m128 maxChannel = _mm_max_ps(_mm_max_ps(r, g), b);
+
+			// exponent = max(floor(log2(maxChannel)), -16) + 16, denormals and 0 have a biased exponent of 0
+			const __m128i floorLog2 = _mm_and_si128(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), exponentMask);
+			__m128i exponent = _mm_sub_epi32(floorLog2, _mm_set1_epi32(127 - 16));
+			exponent = _mm_and_si128(exponent, _mm_cmpgt_epi32(exponent, _mm_setzero_si128()));
+
+			// 2^(15 + 9 - exponent)
+			__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), exponent), 23));
+
+			// rounding the largest channel up to 2^9 needs the next exponent
+			const __m128i maxScaled = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxChannel, scale), half));
+			const __m128i overflow = _mm_cmpeq_epi32(maxScaled, _mm_set1_epi32(512));
+			exponent = _mm_sub_epi32(exponent, overflow);
+			scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), exponent), 23));
+
+			const __m128i rs = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+			const __m128i gs = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+			const __m128i bs = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+
+			__m128i packed = _mm_or_si128(rs, _mm_slli_epi32(gs, 9));
+			packed = _mm_or_si128(packed, _mm_slli_epi32(bs, 18));
+			packed = _mm_or_si128(packed, _mm_slli_epi32(exponent, 27));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), packed);
+		}
+
+		for (; i < _texelCount; ++i)
+		{
+			const float* texel = _src + 4u * i;
+			_dst[i] = IBLLib::floatToE5B9G9R9(texel[0], texel[1], texel[2]);
+		}
+	}
+#endif
+}
+
+void IBLLib::rgbeToFloat(const uint8_t* _rgbe, float* _outRGBA, size_t _texelCount)
+{
+	size_t i = 0u;
+
+#if IBLSAMPLER_AVX2
+	for (; i + 2u <= _texelCount; i += 2u)
+	{
+		const __m256i rgbe = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_rgbe + 4u * i)));
+		_mm256_storeu_ps(_outRGBA + 4u * i, rgbeToFloatAVX2(rgbe));
+	}
+#elif IBLSAMPLER_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4u <= _texelCount; i += 4u)
+	{
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_rgbe + 4u * i));
+		const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_ps(_outRGBA + 4u * i, rgbeToFloatSSE2(_mm_unpacklo_epi16(lo, zero)));
+		_mm_storeu_ps(_outRGBA + 4u * i + 4u, rgbeToFloatSSE2(_mm_unpackhi_epi16(lo, zero)));
+		_mm_storeu_ps(_outRGBA + 4u * i + 8u, rgbeToFloatSSE2(_mm_unpacklo_epi16(hi, zero)));
+		_mm_storeu_ps(_outRGBA + 4u * i + 12u, rgbeToFloatSSE2(_mm_unpackhi_epi16(hi, zero)));
+	}
+#endif
+
+	for (; i < _texelCount; ++i)
+	{
+		const uint8_t* rgbe = _rgbe + 4u * i;
+		float* rgba = _outRGBA + 4u * i;
+
+		if (rgbe[3] != 0u)
+		{
+			const float scale = static_cast<float>(ldexp(1.0f, rgbe[3] - (128 + 8)));
+			rgba[0] = rgbe[0] * scale;
+			rgba[1] = rgbe[1] * scale;
+			rgba[2] = rgbe[2] * scale;
+		}
+		else
+		{
+			rgba[0] = rgba[1] = rgba[2] = 0.0f;
+		}
+
+		rgba[3] = 1.0f;
+	}
+}
+
+bool IBLLib::convertRGBE(const uint8_t* _rgbe, void* _dst, size_t _texelCount, VkFormat _format)
+{
+	if (_format == VK_FORMAT_R32G32B32A32_SFLOAT)
+	{
+		rgbeToFloat(_rgbe, static_cast<float*>(_dst), _texelCount);
+		return true;
+	}
+
+	const uint32_t dstTexelSize = getFormatSize(_format);
+	uint8_t* pDst = static_cast<uint8_t*>(_dst);
+
+	// small blocks stay in L1 between the two passes
+	float block[4u * g_RGBEBlockSize];
+
+	for (size_t i = 0u; i < _texelCount; i += g_RGBEBlockSize)
+	{
+		const size_t count = std::min(g_RGBEBlockSize, _texelCount - i);
+		rgbeToFloat(_rgbe + 4u * i, block, count);
+
+		if (convertRGBA32F(block, pDst + i * dstTexelSize, count, _format) == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint16_t IBLLib::floatToHalf(float _value)
+{
+	uint32_t bits = asUint(_value);
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+	bits &= 0x7fffffffu;
+
+	// also catches inf and NaN
+	if (bits >= g_HalfMaxBits)
+	{
+		return sign | 0x7bffu;
+	}
+
+	if (bits < g_HalfMinNormalBits)
+	{
+		return sign | static_cast<uint16_t>(asUint(asFloat(bits) + asFloat(g_HalfDenormMagicBits)) - g_HalfDenormMagicBits);
+	}
+
+	const uint32_t mantissaOdd = (bits >> 13) & 1u;
+	bits += ((15u - 127u) << 23) + 0xfffu + mantissaOdd;
+
+	return sign | static_cast<uint16_t>(bits >> 13);
+}
+
+uint32_t IBLLib::floatToE5B9G9R9(float _r, float _g, float _b)
+{
+	const float r = clampSharedExp(_r);
+	const float g = clampSharedExp(_g);
+	const float b = clampSharedExp(_b);
+	const float maxChannel = std::max(std::max(r, g), b);
+
+	const int floorLog2 = static_cast<int>((asUint(maxChannel) >> 23) & 0xffu) - 127;
+	uint32_t exponent = static_cast<uint32_t>(std::max(floorLog2, -16) + 16);
+
+	float scale = asFloat((127u + 24u - exponent) << 23);
+	if (roundScaled(maxChannel, scale) == 512u)
+	{
+		++exponent;
+		scale *= 0.5f;
+	}
+
+	return roundScaled(r, scale) | (roundScaled(g, scale) << 9) | (roundScaled(b, scale) << 18) | (exponent << 27);
+}
+
+bool IBLLib::convertRGBA32F(const float* _src, void* _dst, size_t _texelCount, VkFormat _format)
+{
+	switch (_format)
+	{
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		memcpy(_dst, _src, _texelCount * 4u * sizeof(float));
+		return true;
+
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+#if IBLSAMPLER_SSE2
+		convertToHalfSSE2(_src, static_cast<uint16_t*>(_dst), 4u * _texelCount);
+#else
+		for (size_t i = 0u; i < 4u * _texelCount; ++i)
+		{
+			static_cast<uint16_t*>(_dst)[i] = floatToHalf(_src[i]);
+		}
+#endif
+		return true;
+
+	case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+#if IBLSAMPLER_SSE2
+		convertToE5B9G9R9SSE2(_src, static_cast<uint32_t*>(_dst), _texelCount);
+#else
+		for (size_t i = 0u; i < _texelCount; ++i)
+		{
+			static_cast<uint32_t*>(_dst)[i] = floatToE5B9G9R9(_src[4u * i], _src[4u * i + 1u], _src[4u * i + 2u]);
+		}
+#endif
+		return true;
+
+	default:
+		return false;
+	}
+}
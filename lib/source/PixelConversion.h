@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace IBLLib
+{
+	// packs _texelCount RGBA32F texels into _dst in _format while filling upload buffers.
+	// supported: R32G32B32A32_SFLOAT (copy), R16G16B16A16_SFLOAT and E5B9G9R9_UFLOAT_PACK32 (alpha dropped).
+	// values are clamped to the range of the target format, returns false for any other format
+	bool convertRGBA32F(const float* _src, void* _dst, size_t _texelCount, VkFormat _format);
+
+	// expands _texelCount Radiance RGBE texels to RGBA32F (alpha = 1), same results as stbi_loadf
+	void rgbeToFloat(const uint8_t* _rgbe, float* _outRGBA, size_t _texelCount);
+
+	// RGBE texels to any format supported by convertRGBA32F without a full size float intermediate
+	bool convertRGBE(const uint8_t* _rgbe, void* _dst, size_t _texelCount, VkFormat _format);
+
+	// round to nearest even, clamped to +-65504
+	uint16_t floatToHalf(float _value);
+
+	// negative values and NaN become 0
+	uint32_t floatToE5B9G9R9(float _r, float _g, float _b);
+} // IBLLib
@@ -0,0 +1,521 @@
+#include "RenderGraph.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+	struct AccessInfo
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		bool write;
+	};
+
+	// indexed by RenderGraph::Access
+	const AccessInfo g_AccessInfos[] =
+	{
+		{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+	};
+
+	static_assert(sizeof(g_AccessInfos) / sizeof(g_AccessInfos[0]) == static_cast<size_t>(IBLLib::RenderGraph::Access::Count), "missing access info");
+
+	constexpr VkAccessFlags g_WriteAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+}
+
+IBLLib::RenderGraph::Pass& IBLLib::RenderGraph::Pass::use(ImageHandle _image, Access _access)
+{
+	m_uses.push_back({ _image, _access });
+	return *this;
+}
+
+IBLLib::RenderGraph::Pass& IBLLib::RenderGraph::Pass::record(RecordFunction _record)
+{
+	m_record = std::move(_record);
+	return *this;
+}
+
+IBLLib::RenderGraph::RenderGraph(vkHelper& _vulkan) :
+	m_vulkan(_vulkan)
+{
+}
+
+IBLLib::RenderGraph::~RenderGraph()
+{
+	// submitted without wait, the images are still in use
+	if (m_fence != VK_NULL_HANDLE)
+	{
+		m_vulkan.waitForSubmission(m_fence);
+	}
+}
+
+IBLLib::RenderGraph::ImageHandle IBLLib::RenderGraph::createImage2D(const char* _name, uint32_t _width, uint32_t _height, VkFormat _format, VkImageUsageFlags _usage, uint32_t _mipLevels, uint32_t _arrayLayers, VkImageCreateFlags _flags)
+{
+	m_images.emplace_back(m_vulkan);
+	Image& img = m_images.back();
+
+	img.name = _name;
+	m_vulkan.fillImage2DCreateInfo(img.info, _width, _height, _format, _usage, _mipLevels, _arrayLayers, VK_IMAGE_TILING_OPTIMAL, VK_SHARING_MODE_EXCLUSIVE, _flags);
+
+	return static_cast<ImageHandle>(m_images.size() - 1u);
+}
+
+void IBLLib::RenderGraph::setInitialAccess(ImageHandle _image, Access _access)
+{
+	if (_image < m_images.size() && _access < Access::Count)
+	{
+		m_images[_image].initialized = true;
+		m_images[_image].initialAccess = _access;
+	}
+}
+
+void IBLLib::RenderGraph::markOutput(ImageHandle _image)
+{
+	if (_image < m_images.size())
+	{
+		m_images[_image].output = true;
+	}
+}
+
+IBLLib::RenderGraph::Pass& IBLLib::RenderGraph::addPass(const char* _name)
+{
+	m_passes.emplace_back();
+	m_passes.back().m_name = _name;
+	return m_passes.back();
+}
+
+VkResult IBLLib::RenderGraph::compile()
+{
+	if (m_compiled)
+	{
+		return VK_SUCCESS;
+	}
+
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+
+	for (uint32_t p = 0u; p < passCount; ++p)
+	{
+		for (const Pass::Use& use : m_passes[p].m_uses)
+		{
+			if (use.image >= m_images.size() || use.access >= Access::Count)
+			{
+				printf("Invalid image use in pass %s\n", m_passes[p].m_name);
+				return VK_RESULT_MAX_ENUM;
+			}
+
+			Image& img = m_images[use.image];
+			img.firstPass = std::min(img.firstPass, p);
+			img.lastPass = std::max(img.lastPass, p);
+		}
+	}
+
+	std::vector<ImageHandle> order;
+	for (ImageHandle i = 0u; i < m_images.size(); ++i)
+	{
+		Image& img = m_images[i];
+
+		if (img.initialized)
+		{
+			// alive before the first pass
+			img.firstPass = 0u;
+		}
+
+		if (img.firstPass == UINT32_MAX)
+		{
+			// unused, keep it alive for the whole graph
+			img.firstPass = 0u;
+			img.lastPass = passCount;
+		}
+
+		if (img.output)
+		{
+			img.lastPass = passCount;
+		}
+
+		order.push_back(i);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](ImageHandle _a, ImageHandle _b) { return m_images[_a].firstPass < m_images[_b].firstPass; });
+
+	// greedy interval assignment, an image joins the first group whose last user finished before the image is first used
+	std::vector<std::vector<ImageHandle>> groups;
+	m_aliasGroups.clear();
+
+	for (ImageHandle i : order)
+	{
+		Image& img = m_images[i];
+
+		uint32_t group = 0u;
+		for (; group < m_aliasGroups.size() && m_aliasGroups[group].lastPass >= img.firstPass; ++group) {}
+
+		if (group == m_aliasGroups.size())
+		{
+			m_aliasGroups.emplace_back();
+			groups.emplace_back();
+		}
+
+		img.aliasGroup = group;
+		m_aliasGroups[group].lastPass = img.lastPass;
+		groups[group].push_back(i);
+	}
+
+	VkResult res = VK_SUCCESS;
+
+	for (const std::vector<ImageHandle>& group : groups)
+	{
+		std::vector<VkImageCreateInfo> infos;
+		for (ImageHandle i : group)
+		{
+			infos.push_back(m_images[i].info);
+		}
+
+		std::vector<VkImage> images;
+		if (group.size() == 1u)
+		{
+			const VkImageCreateInfo& info = infos.front();
+			images.resize(1u, VK_NULL_HANDLE);
+			res = m_vulkan.createImage2DAndAllocate(images.front(), info.extent.width, info.extent.height, info.format, info.usage,
+				info.mipLevels, info.arrayLayers, info.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, info.sharingMode, info.flags);
+		}
+		else
+		{
+			res = m_vulkan.createAliasedImages(images, infos);
+		}
+
+		for (size_t i = 0; i < images.size(); ++i)
+		{
+			m_images[group[i]].image = UniqueImage(m_vulkan, images[i]);
+		}
+
+		if (res != VK_SUCCESS)
+		{
+			printf("Failed to create render graph image %s [%u]\n", m_images[group.front()].name, res);
+			return res;
+		}
+	}
+
+	for (AliasGroup& group : m_aliasGroups)
+	{
+		group.lastImage = UINT32_MAX;
+	}
+
+	m_compiled = true;
+
+	return res;
+}
+
+VkImage IBLLib::RenderGraph::getImage(ImageHandle _image) const
+{
+	return _image < m_images.size() ? m_images[_image].image.get() : VK_NULL_HANDLE;
+}
+
+VkImageLayout IBLLib::RenderGraph::getLayout(ImageHandle _image) const
+{
+	return _image < m_images.size() ? m_images[_image].layout : VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+void IBLLib::RenderGraph::addBarrier(Image& _image, Access _access, std::vector<VkImageMemoryBarrier>& _barriers, VkPipelineStageFlags& _srcStages, VkPipelineStageFlags& _dstStages)
+{
+	const AccessInfo& info = g_AccessInfos[static_cast<uint32_t>(_access)];
+
+	VkPipelineStageFlags srcStages = 0u;
+	VkAccessFlags srcAccess = 0u;
+	VkImageLayout oldLayout = _image.layout;
+
+	AliasGroup& group = m_aliasGroups[_image.aliasGroup];
+	const ImageHandle self = static_cast<ImageHandle>(&_image - m_images.data());
+
+	if (group.lastImage != self)
+	{
+		// first use, contents are undefined. wait for the previous image living in the same memory
+		if (group.lastImage != UINT32_MAX)
+		{
+			const Image& previous = m_images[group.lastImage];
+			srcStages = previous.writeStages | previous.readStages;
+			srcAccess = previous.writeAccess;
+		}
+
+		oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		group.lastImage = self;
+	}
+	else
+	{
+		const bool layoutChange = _image.layout != info.layout;
+
+		if (layoutChange || info.write)
+		{
+			// write after write / read, layout transitions count as writes
+			srcStages = _image.writeStages | _image.readStages;
+			srcAccess = _image.writeAccess;
+		}
+		else if (_image.writeStages != 0u && (info.stages & ~_image.visibleStages) != 0u)
+		{
+			// read after write from a stage that does not see the write yet
+			srcStages = _image.writeStages;
+			srcAccess = _image.writeAccess;
+		}
+		else
+		{
+			// read after read in the same layout
+			_image.readStages |= info.stages;
+			return;
+		}
+	}
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = info.layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = _image.image.get();
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, _image.info.mipLevels, 0u, _image.info.arrayLayers };
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = info.access;
+
+	_barriers.push_back(barrier);
+	_srcStages |= srcStages;
+	_dstStages |= info.stages;
+
+	if (info.write || oldLayout != info.layout)
+	{
+		_image.writeStages = info.stages;
+		_image.writeAccess = info.access & g_WriteAccessMask;
+		_image.readStages = info.write ? 0u : info.stages;
+		_image.visibleStages = info.stages;
+	}
+	else
+	{
+		_image.readStages |= info.stages;
+		_image.visibleStages |= info.stages;
+	}
+
+	_image.layout = info.layout;
+}
+
+IBLLib::Result IBLLib::RenderGraph::execute(std::vector<double>* _outPassMilliseconds)
+{
+	const Result res = submit(_outPassMilliseconds != nullptr);
+	if (res != Result::Success)
+	{
+		return res;
+	}
+
+	return wait(_outPassMilliseconds);
+}
+
+IBLLib::Result IBLLib::RenderGraph::submit(bool _measurePasses)
+{
+	TraceZone zone("RenderGraph::submit");
+
+	if (m_compiled == false && compile() != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
+
+	if (m_fence != VK_NULL_HANDLE)
+	{
+		return Result::InvalidArgument;
+	}
+
+	if (m_vulkan.createCommandBuffer(m_cmdBuffer) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
+
+	const VkCommandBuffer cmdBuffer = m_cmdBuffer;
+
+	// every failure after this point is not submitted, nothing waits for the command buffer
+	const auto fail = [this](Result _res) -> Result
+	{
+		m_vulkan.destroyCommandBuffer(m_cmdBuffer);
+		m_cmdBuffer = VK_NULL_HANDLE;
+		return _res;
+	};
+
+	if (m_vulkan.beginCommandBuffer(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
+	{
+		return fail(Result::VulkanError);
+	}
+
+	Result res = Result::Success;
+
+	// state left behind by work submitted before the graph
+	for (ImageHandle i = 0u; i < m_images.size(); ++i)
+	{
+		Image& img = m_images[i];
+		if (img.initialized)
+		{
+			const AccessInfo& info = g_AccessInfos[static_cast<uint32_t>(img.initialAccess)];
+			img.layout = info.layout;
+			img.writeStages = info.write ? info.stages : 0u;
+			img.writeAccess = info.access & g_WriteAccessMask;
+			img.readStages = info.write ? 0u : info.stages;
+			img.visibleStages = 0u;
+			m_aliasGroups[img.aliasGroup].lastImage = i;
+		}
+	}
+
+	std::vector<VkImageMemoryBarrier> barriers;
+
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+	// timestamps are also written for the GPU track of a trace
+	const bool timestamps = passCount != 0u && (_measurePasses || isTracing()) && m_vulkan.supportsTimestamps();
+	const bool serialize = _measurePasses && timestamps == false;
+
+	// two timestamps per pass
+	m_queryPool = VK_NULL_HANDLE;
+	if (timestamps)
+	{
+		if (m_vulkan.createTimestampQueryPool(m_queryPool, 2u * passCount) != VK_SUCCESS)
+		{
+			return fail(Result::VulkanError);
+		}
+
+		vkCmdResetQueryPool(cmdBuffer, m_queryPool, 0u, 2u * passCount);
+	}
+
+	m_serialPassMilliseconds.assign(serialize ? passCount : 0u, 0.0);
+
+	for (uint32_t p = 0u; p < passCount; ++p)
+	{
+		Pass& pass = m_passes[p];
+		const auto start = std::chrono::steady_clock::now();
+
+		// written once all earlier commands are done, the intervals of the passes do not overlap
+		if (timestamps)
+		{
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2u * p);
+		}
+
+		barriers.clear();
+		VkPipelineStageFlags srcStages = 0u;
+		VkPipelineStageFlags dstStages = 0u;
+
+		for (const Pass::Use& use : pass.m_uses)
+		{
+			addBarrier(m_images[use.image], use.access, barriers, srcStages, dstStages);
+		}
+
+		if (barriers.empty() == false)
+		{
+			vkCmdPipelineBarrier(cmdBuffer,
+				srcStages != 0u ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages,
+				0u,
+				0u, nullptr,
+				0u, nullptr,
+				static_cast<uint32_t>(barriers.size()), barriers.data());
+		}
+
+		if (pass.m_record && (res = pass.m_record(cmdBuffer)) != Result::Success)
+		{
+			printf("Failed to record pass %s\n", pass.m_name);
+			return fail(res);
+		}
+
+		if (timestamps)
+		{
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2u * p + 1u);
+		}
+
+		if (serialize)
+		{
+			// the command buffer is reset when it is begun again
+			if (m_vulkan.endCommandBuffer(cmdBuffer) != VK_SUCCESS ||
+				m_vulkan.executeCommandBuffer(cmdBuffer) != VK_SUCCESS ||
+				m_vulkan.beginCommandBuffer(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
+			{
+				return fail(Result::VulkanError);
+			}
+
+			m_serialPassMilliseconds[p] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	if (m_vulkan.endCommandBuffer(cmdBuffer) != VK_SUCCESS)
+	{
+		return fail(Result::VulkanError);
+	}
+
+	if (m_vulkan.submitCommandBuffers({ cmdBuffer }, m_fence) != VK_SUCCESS)
+	{
+		return fail(Result::VulkanError);
+	}
+
+	return res;
+}
+
+IBLLib::Result IBLLib::RenderGraph::wait(std::vector<double>* _outPassMilliseconds)
+{
+	TraceZone zone("RenderGraph::wait");
+
+	if (m_fence == VK_NULL_HANDLE)
+	{
+		return Result::InvalidArgument;
+	}
+
+	const VkResult waitResult = m_vulkan.waitForSubmission(m_fence);
+	m_fence = VK_NULL_HANDLE;
+
+	if (waitResult != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
+
+	const double completedMicroseconds = traceNow();
+
+	m_vulkan.destroyCommandBuffer(m_cmdBuffer);
+	m_cmdBuffer = VK_NULL_HANDLE;
+
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+
+	if (_outPassMilliseconds != nullptr && m_serialPassMilliseconds.empty() == false)
+	{
+		*_outPassMilliseconds = m_serialPassMilliseconds;
+	}
+
+	if (m_queryPool != VK_NULL_HANDLE)
+	{
+		std::vector<double> milliseconds;
+		if (m_vulkan.getTimestamps(m_queryPool, 2u * passCount, milliseconds) != VK_SUCCESS)
+		{
+			return Result::VulkanError;
+		}
+
+		if (_outPassMilliseconds != nullptr)
+		{
+			_outPassMilliseconds->resize(passCount);
+			for (uint32_t p = 0u; p < passCount; ++p)
+			{
+				(*_outPassMilliseconds)[p] = milliseconds[2u * p + 1u] - milliseconds[2u * p];
+			}
+		}
+
+		// the GPU clock is not calibrated against the CPU clock, the last pass is placed to end when the wait returned
+		const double lastMilliseconds = milliseconds.back();
+		for (uint32_t p = 0u; p < passCount; ++p)
+		{
+			traceGpuInterval(m_passes[p].m_name, completedMicroseconds - 1000.0 * (lastMilliseconds - milliseconds[2u * p]),
+				1000.0 * (milliseconds[2u * p + 1u] - milliseconds[2u * p]));
+		}
+	}
+
+	// everything but the outputs is done
+	for (Image& img : m_images)
+	{
+		if (img.output == false)
+		{
+			img.image.reset();
+		}
+	}
+
+	return Result::Success;
+}
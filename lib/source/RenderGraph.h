@@ -0,0 +1,139 @@
+#pragma once
+
+#include "vkHelper.h"
+#include "ResultType.h"
+#include <functional>
+#include <vector>
+
+namespace IBLLib
+{
+	// records a fixed sequence of passes into one command buffer. passes declare how they use images and the graph
+	// emits a single batched barrier in front of each pass with the layouts, stages and access masks derived from that.
+	// images are created by the graph, images whose lifetimes (first to last using pass) do not overlap share memory
+	class RenderGraph
+	{
+	public:
+		using ImageHandle = uint32_t;
+
+		enum class Access : uint32_t
+		{
+			SampledRead = 0, // fragment shader sampling
+			ColorAttachmentWrite, // render target
+			TransferRead, // copy / blit source
+			TransferWrite, // copy / blit destination
+			TransferReadWrite, // blits within the image (mip generation), the pass has to leave all subresources in TRANSFER_SRC_OPTIMAL
+			ComputeSampledRead, // compute shader sampling
+			StorageWrite, // compute shader image stores
+			Count
+		};
+
+		using RecordFunction = std::function<Result(VkCommandBuffer _cmdBuffer)>;
+
+		class Pass
+		{
+		public:
+			// covers all subresources of _image, use each image at most once per pass
+			Pass& use(ImageHandle _image, Access _access);
+
+			Pass& record(RecordFunction _record);
+
+		private:
+			friend class RenderGraph;
+
+			struct Use
+			{
+				ImageHandle image;
+				Access access;
+			};
+
+			const char* m_name = nullptr;
+			std::vector<Use> m_uses;
+			RecordFunction m_record;
+		};
+
+		RenderGraph(vkHelper& _vulkan);
+		~RenderGraph();
+
+		ImageHandle createImage2D(const char* _name, uint32_t _width, uint32_t _height,
+			VkFormat _format, VkImageUsageFlags _usage,
+			uint32_t _mipLevels = 1u, uint32_t _arrayLayers = 1u,
+			VkImageCreateFlags _flags = 0);
+
+		// _image is written outside the graph before execute (e.g. a streamed upload) and left in the state of _access.
+		// its contents are kept on first use instead of being discarded
+		void setInitialAccess(ImageHandle _image, Access _access);
+
+		// outputs are kept after execute and never share memory with images used after their last pass
+		void markOutput(ImageHandle _image);
+
+		// passes execute in the order they were added, the returned reference is only valid until the next addPass
+		Pass& addPass(const char* _name);
+
+		// index of the next added pass
+		uint32_t getPassCount() const { return static_cast<uint32_t>(m_passes.size()); }
+
+		// computes image lifetimes, creates the images and assigns aliased memory
+		VkResult compile();
+
+		// images are valid after compile, non output images are released by execute
+		VkImage getImage(ImageHandle _image) const;
+
+		// layout after the last executed pass
+		VkImageLayout getLayout(ImageHandle _image) const;
+
+		// records all passes into one command buffer and executes it (blocking).
+		// _outPassMilliseconds receives the GPU time of every pass in pass order, measured with timestamps around each pass.
+		// if the queue has no timestamps every pass is submitted and waited for on its own and its wall clock time is returned
+		Result execute(std::vector<double>* _outPassMilliseconds = nullptr);
+
+		// execute split in two: submit records and submits the passes without waiting, so work recorded afterwards
+		// (e.g. readbacks of the outputs) can be queued behind them. wait blocks until they completed and then releases
+		// the images like execute. _measurePasses and _outPassMilliseconds match the argument of execute
+		Result submit(bool _measurePasses = false);
+		Result wait(std::vector<double>* _outPassMilliseconds = nullptr);
+
+	private:
+		struct Image
+		{
+			Image(vkHelper& _vulkan) : image(_vulkan) {}
+
+			const char* name = nullptr;
+			VkImageCreateInfo info{};
+			UniqueImage image;
+			bool output = false;
+			bool initialized = false;
+			Access initialAccess = Access::Count;
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0u;
+			uint32_t aliasGroup = UINT32_MAX;
+
+			// state while recording
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags writeStages = 0u; // stages of the last write or layout transition
+			VkAccessFlags writeAccess = 0u; // not yet made available
+			VkPipelineStageFlags readStages = 0u; // reads since the last write
+			VkPipelineStageFlags visibleStages = 0u; // stages that already see the last write
+		};
+
+		// previous user of the memory, the first use of the next image has to wait for it
+		struct AliasGroup
+		{
+			uint32_t lastPass = 0u;
+			ImageHandle lastImage = UINT32_MAX;
+		};
+
+		void addBarrier(Image& _image, Access _access, std::vector<VkImageMemoryBarrier>& _barriers, VkPipelineStageFlags& _srcStages, VkPipelineStageFlags& _dstStages);
+
+		vkHelper& m_vulkan;
+		std::vector<Image> m_images;
+		std::vector<Pass> m_passes;
+		std::vector<AliasGroup> m_aliasGroups;
+		bool m_compiled = false;
+
+		// between submit and wait
+		VkCommandBuffer m_cmdBuffer = VK_NULL_HANDLE;
+		VkFence m_fence = VK_NULL_HANDLE;
+		VkQueryPool m_queryPool = VK_NULL_HANDLE; // if the passes are timed with timestamps
+		std::vector<double> m_serialPassMilliseconds; // if the passes were measured one submission at a time
+	};
+} // IBLLib
@@ -1,4 +1,7 @@
 #include "STBImage.h"
+#include "FileHelper.h"
+#include "Trace.h"
+#include <limits.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -6,6 +9,15 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+namespace
+{
+	// stb decodes from the mapped file instead of its small stdio buffer, it takes the length as int
+	bool mapFile(IBLLib::MappedFile& _file, const char* _path)
+	{
+		return _file.open(_path) && _file.getSize() <= static_cast<size_t>(INT_MAX);
+	}
+}
+
 IBLLib::STBImage::~STBImage()
 {
 	if (m_byteData != nullptr)
@@ -17,22 +29,31 @@ IBLLib::STBImage::~STBImage()
 
 IBLLib::Result IBLLib::STBImage::saveHdr(const char* _path, int _width, int _height, int _channels, const void* data)
 {
+	TraceZone zone("STBImage::saveHdr");
+
 	return stbi_write_hdr(_path, _width, _height, _channels, (const float* )data) == 0 ? StbError : Success;
 }
 
 IBLLib::Result IBLLib::STBImage::savePng(const char* _path, int _width, int _height, int _channels, const void* data)
-{	
+{
+	TraceZone zone("STBImage::savePng");
+
 	return stbi_write_png(_path, _width, _height, _channels, data, _width * _channels) == 0 ? StbError : Success;
 }
 
 IBLLib::Result IBLLib::STBImage::loadHdr(const char* _path)
 {
+	TraceZone zone("STBImage::loadHdr");
+
 	if (m_hdrData != nullptr)
 	{
 		return InvalidArgument;
 	}
 
-	int isHdrFile = stbi_is_hdr(_path); // 0 == false, 1 == true
+	MappedFile file;
+	const bool mapped = mapFile(file, _path);
+
+	int isHdrFile = mapped ? stbi_is_hdr_from_memory(file.getData(), static_cast<int>(file.getSize())) : stbi_is_hdr(_path); // 0 == false, 1 == true
 
 	if (isHdrFile == 0)
 	{
@@ -41,7 +62,9 @@ IBLLib::Result IBLLib::STBImage::loadHdr(const char* _path)
 	}
 
 	// stbi_loadf
-	m_hdrData = stbi_loadf(_path, &m_width, &m_height, &m_channels, STBI_rgb_alpha);
+	m_hdrData = mapped ?
+		stbi_loadf_from_memory(file.getData(), static_cast<int>(file.getSize()), &m_width, &m_height, &m_channels, STBI_rgb_alpha) :
+		stbi_loadf(_path, &m_width, &m_height, &m_channels, STBI_rgb_alpha);
 
 	if (m_hdrData == nullptr)
 	{
@@ -58,6 +81,11 @@ IBLLib::Result IBLLib::STBImage::loadHdr(const char* _path)
 	}
 }
 
+bool IBLLib::STBImage::isHdrFile(const char* _path)
+{
+	return stbi_is_hdr(_path) != 0;
+}
+
 size_t IBLLib::STBImage::getByteSize() const
 {
 	if(m_isHdr)
@@ -67,13 +95,19 @@ size_t IBLLib::STBImage::getByteSize() const
 }		
 
 IBLLib::Result IBLLib::STBImage::loadPng(const char* _path)
-{ 
+{
+	TraceZone zone("STBImage::loadPng");
+
 	if (m_byteData != nullptr)
 	{
 		return InvalidArgument;
 	}
 
-	m_byteData = stbi_load(_path, &m_width, &m_height, &m_channels, STBI_rgb_alpha);
+	MappedFile file;
+
+	m_byteData = mapFile(file, _path) ?
+		stbi_load_from_memory(file.getData(), static_cast<int>(file.getSize()), &m_width, &m_height, &m_channels, STBI_rgb_alpha) :
+		stbi_load(_path, &m_width, &m_height, &m_channels, STBI_rgb_alpha);
 
 	if (m_byteData == nullptr)
 	{
@@ -18,6 +18,12 @@ namespace IBLLib
 		Result loadPng(const char* _path);
 		size_t getByteSize() const;
 
+		// true for float data (loadHdr), false for 8 bit RGBA (loadPng)
+		bool isHdr() const { return m_isHdr; }
+
+		// checks the file header without decoding
+		static bool isHdrFile(const char* _path);
+
 		const float* getHdrData() const { return m_hdrData; }
 		const unsigned char* getByteData() const { return m_byteData; }
 
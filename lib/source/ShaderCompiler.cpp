@@ -1,4 +1,5 @@
 #include "ShaderCompiler.h"
+#include "Trace.h"
 
 #include <glslang/Public/ShaderLang.h>
 #include <SPIRV/GlslangToSpv.h>
@@ -111,6 +112,8 @@ static const TBuiltInResource DefaultTBuiltInResource = {
 
 bool IBLLib::ShaderCompiler::compile(const std::string& _glslBlob, const char* _entryPoint, Stage _stage, std::vector<uint32_t>& _outSpvBlob)
 {
+	TraceZone zone("ShaderCompiler::compile");
+
 	_outSpvBlob.clear();
 
 	glslang::TProgram prog;
@@ -154,7 +157,10 @@ bool IBLLib::ShaderCompiler::compile(const std::string& _glslBlob, const char* _
 
 	spv::SpvBuildLogger logger;
 	glslang::SpvOptions spvOptions{};
-	spvOptions.optimizeSize = true;
+	// SpvOptions disables the optimizer by default. glslang runs its SPIRV-Tools performance passes if it was built
+	// with them (ENABLE_OPT), otherwise the output stays unoptimized
+	spvOptions.disableOptimizer = false;
+	spvOptions.optimizeSize = false;
 	spvOptions.validate = true;
 	spvOptions.disassemble = false;
 
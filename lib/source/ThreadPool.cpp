@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+IBLLib::ThreadPool::ThreadPool(uint32_t _threadCount)
+{
+	if (_threadCount == 0u)
+	{
+		_threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_workers.reserve(_threadCount - 1u);
+	for (uint32_t i = 1u; i < _threadCount; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+IBLLib::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void IBLLib::ThreadPool::parallelFor(uint32_t _count, const std::function<void(uint32_t)>& _task)
+{
+	if (m_workers.empty() || _count < 2u)
+	{
+		for (uint32_t i = 0u; i < _count; ++i)
+		{
+			_task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &_task;
+		m_count = _count;
+		m_next = 0u;
+		m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+
+	m_wake.notify_all();
+
+	runTasks();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busyWorkers == 0u; });
+	m_task = nullptr;
+}
+
+void IBLLib::ThreadPool::workerLoop()
+{
+	uint64_t generation = 0u;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+
+			if (m_stop)
+			{
+				return;
+			}
+
+			generation = m_generation;
+		}
+
+		runTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busyWorkers == 0u)
+			{
+				m_done.notify_one();
+			}
+		}
+	}
+}
+
+void IBLLib::ThreadPool::runTasks()
+{
+	for (uint32_t i = m_next++; i < m_count; i = m_next++)
+	{
+		(*m_task)(i);
+	}
+}
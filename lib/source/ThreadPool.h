@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace IBLLib
+{
+	// fixed set of worker threads for data parallel CPU work (image decoding and conversion)
+	class ThreadPool
+	{
+	public:
+		// 0 uses one thread per hardware thread, the calling thread counts as one of them
+		explicit ThreadPool(uint32_t _threadCount = 0u);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// including the calling thread
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1u; }
+
+		// calls _task(i) for every i in [0, _count) on the workers and the calling thread, returns when all calls finished.
+		// not reentrant, _task must not call parallelFor on the same pool
+		void parallelFor(uint32_t _count, const std::function<void(uint32_t)>& _task);
+
+	private:
+		void workerLoop();
+		void runTasks();
+
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+
+		const std::function<void(uint32_t)>* m_task = nullptr;
+		uint32_t m_count = 0u;
+		std::atomic<uint32_t> m_next{ 0u };
+		uint32_t m_busyWorkers = 0u;
+		uint64_t m_generation = 0u;
+		bool m_stop = false;
+	};
+} // !IBLLib
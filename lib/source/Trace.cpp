@@ -0,0 +1,134 @@
+#include "Trace.h"
+#include "FileHelper.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		double start; // microseconds
+		double duration;
+		uint32_t thread; // 0 is the GPU track
+	};
+
+	std::mutex g_traceMutex;
+	std::vector<Event> g_events;
+	// small ids for the trace file, in the order the threads recorded their first zone
+	std::unordered_map<std::thread::id, uint32_t> g_threadIds;
+
+	const std::chrono::steady_clock::time_point g_traceEpoch = std::chrono::steady_clock::now();
+
+	void addEvent(const char* _name, double _start, double _duration, bool _gpu)
+	{
+		std::lock_guard<std::mutex> lock(g_traceMutex);
+
+		// the recording ended while the zone was open
+		if (IBLLib::isTracing() == false)
+		{
+			return;
+		}
+
+		uint32_t thread = 0u;
+		if (_gpu == false)
+		{
+			thread = g_threadIds.emplace(std::this_thread::get_id(), static_cast<uint32_t>(g_threadIds.size()) + 1u).first->second;
+		}
+
+		g_events.push_back({ _name, _start, _duration, thread });
+	}
+
+	void appendJsonString(std::string& _json, const char* _value)
+	{
+		_json += '"';
+		for (const char* c = _value; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				_json += '\\';
+			}
+			_json += *c;
+		}
+		_json += '"';
+	}
+} // !anonymous namespace
+
+std::atomic<bool> IBLLib::g_traceEnabled(false);
+
+double IBLLib::traceNow()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_traceEpoch).count();
+}
+
+void IBLLib::traceGpuInterval(const char* _name, double _startMicroseconds, double _durationMicroseconds)
+{
+	if (isTracing())
+	{
+		addEvent(_name, _startMicroseconds, _durationMicroseconds, true);
+	}
+}
+
+void IBLLib::TraceZone::end()
+{
+	addEvent(m_name, m_start, traceNow() - m_start, false);
+}
+
+void IBLLib::beginTrace()
+{
+	std::lock_guard<std::mutex> lock(g_traceMutex);
+
+	g_events.clear();
+	g_threadIds.clear();
+	g_traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+IBLLib::Result IBLLib::endTrace(const char* _path)
+{
+	std::lock_guard<std::mutex> lock(g_traceMutex);
+
+	g_traceEnabled.store(false, std::memory_order_relaxed);
+
+	// complete events ("X") on two processes: CPU threads and the GPU queue
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}},\n";
+	json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"queue\"}}";
+
+	char buffer[128];
+
+	for (const auto& thread : g_threadIds)
+	{
+		snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			thread.second, thread.second);
+		json += buffer;
+	}
+
+	for (const Event& event : g_events)
+	{
+		json += ",\n{\"name\":";
+		appendJsonString(json, event.name);
+		snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			event.thread == 0u ? "gpu" : "cpu", event.thread == 0u ? 2u : 1u, event.thread, event.start, event.duration);
+		json += buffer;
+	}
+
+	json += "\n]}\n";
+
+	g_events.clear();
+	g_threadIds.clear();
+
+	if (writeFile(_path, json.data(), json.size()) == false)
+	{
+		printf("Failed to write trace %s\n", _path);
+		return Result::FileNotFound;
+	}
+
+	return Result::Success;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "GltfIblSampler.h"
+#include <atomic>
+
+namespace IBLLib
+{
+	// beginTrace and endTrace (GltfIblSampler.h) record CPU zones and GPU intervals process wide and write them as
+	// chrome trace events. while no trace is recorded a zone costs one relaxed atomic load
+
+	extern std::atomic<bool> g_traceEnabled;
+
+	inline bool isTracing() { return g_traceEnabled.load(std::memory_order_relaxed); }
+
+	// microseconds on the steady clock, the time base of all events
+	double traceNow();
+
+	// interval on the GPU track. _name has to outlive the recording (string literals)
+	void traceGpuInterval(const char* _name, double _startMicroseconds, double _durationMicroseconds);
+
+	// CPU zone on the calling thread from construction to destruction. _name has to outlive the recording (string literals)
+	class TraceZone
+	{
+	public:
+		explicit TraceZone(const char* _name) :
+			m_name(isTracing() ? _name : nullptr),
+			m_start(m_name != nullptr ? traceNow() : 0.0)
+		{
+		}
+
+		~TraceZone()
+		{
+			if (m_name != nullptr)
+			{
+				end();
+			}
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+
+	private:
+		void end();
+
+		const char* m_name;
+		double m_start;
+	};
+} // !IBLLib
@@ -1,4 +1,5 @@
 #include "ktxImage.h"
+#include "Trace.h"
 
 #include <stdio.h>
 
@@ -7,6 +8,7 @@
 #include <vulkan/vulkan.h>
 
 #include <cassert>
+#include <cstring>
 
 using namespace IBLLib;
 
@@ -14,7 +16,7 @@ KtxImage::KtxImage()
 {
 }
 
-KtxImage::KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32_t _levels, bool _isCubeMap)
+KtxImage::KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32_t _levels, bool _isCubeMap, uint32_t _layers)
 {
 		// fill the create info for ktx2 (we don't support ktx 1)
 	ktxTextureCreateInfo createInfo;
@@ -24,9 +26,9 @@ KtxImage::KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32
 	createInfo.baseDepth = 1u;
 	createInfo.numDimensions = 2u;
 	createInfo.numLevels = _levels;
-	createInfo.numLayers = 1u;
+	createInfo.numLayers = _layers;
 	createInfo.numFaces = _isCubeMap ? 6u : 1u;
-	createInfo.isArray = KTX_FALSE;
+	createInfo.isArray = _layers > 1u ? KTX_TRUE : KTX_FALSE;
 	createInfo.generateMipmaps = KTX_FALSE;
 
 	KTX_error_code result;
@@ -42,21 +44,58 @@ KtxImage::KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32
 
 KtxImage::~KtxImage()
 {
-	ktxTexture_Destroy(ktxTexture(m_ktxTexture));
+	if (m_ktxTexture != nullptr)
+	{
+		ktxTexture_Destroy(ktxTexture(m_ktxTexture));
+	}
+}
+
+bool KtxImage::isKtx2File(const char* _pFilePath)
+{
+	static const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	FILE* file = fopen(_pFilePath, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	uint8_t header[sizeof(identifier)] = {};
+	const size_t bytesRead = fread(header, 1u, sizeof(header), file);
+	fclose(file);
+
+	return bytesRead == sizeof(header) && memcmp(header, identifier, sizeof(identifier)) == 0;
 }
 
 Result KtxImage::loadKtx2(const char* _pFilePath)
 {
-	assert(((void)"m_ktxTexture must be uninitialized.", m_ktxTexture != nullptr));
+	TraceZone zone("KtxImage::loadKtx2");
+
+	assert(((void)"m_ktxTexture must be uninitialized.", m_ktxTexture == nullptr));
+
+	if (m_file.open(_pFilePath) == false)
+	{
+		return Result::FileNotFound;
+	}
 
 	KTX_error_code result;
-	result = ktxTexture2_CreateFromNamedFile(_pFilePath,
-																					KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
-																					&m_ktxTexture);
+	result = ktxTexture2_CreateFromMemory(m_file.getData(), m_file.getSize(),
+																				KTX_TEXTURE_CREATE_NO_FLAGS,
+																				&m_ktxTexture);
 
 	if(result != KTX_SUCCESS)
 	{
 		printf("Could not load ktx file at %s \n", _pFilePath);
+		m_ktxTexture = nullptr;
+		return Result::KtxError;
+	}
+
+	// supercompressed levels have to be inflated by libktx
+	if (m_ktxTexture->supercompressionScheme != KTX_SS_NONE &&
+		ktxTexture_LoadImageData(ktxTexture(m_ktxTexture), nullptr, 0u) != KTX_SUCCESS)
+	{
+		printf("Could not load image data of ktx file at %s \n", _pFilePath);
+		return Result::KtxError;
 	}
 
 	return Result::Success;
@@ -75,8 +114,34 @@ Result KtxImage::writeFace(const std::vector<uint8_t>& _inData, uint32_t _side,
 	return Success;
 }
 
+uint8_t* KtxImage::getStorage(size_t& _outByteSize)
+{
+	if (m_ktxTexture == nullptr)
+	{
+		_outByteSize = 0u;
+		return nullptr;
+	}
+
+	_outByteSize = ktxTexture_GetDataSize(ktxTexture(m_ktxTexture));
+	return ktxTexture_GetData(ktxTexture(m_ktxTexture));
+}
+
+Result KtxImage::getFaceOffset(uint32_t _side, uint32_t _level, uint32_t _layer, size_t& _outOffset) const
+{
+	ktx_size_t offset = 0u;
+
+	if (m_ktxTexture == nullptr || ktxTexture_GetImageOffset(ktxTexture(m_ktxTexture), _level, _layer, _side, &offset) != KTX_SUCCESS)
+	{
+		return Result::KtxError;
+	}
+
+	_outOffset = offset;
+	return Success;
+}
+
 Result KtxImage::save(const char* _pathOut)
 {
+	TraceZone zone("KtxImage::save");
 
 	KTX_error_code result = ktxTexture_WriteToNamedFile(ktxTexture(m_ktxTexture), _pathOut);
 
@@ -91,30 +156,93 @@ Result KtxImage::save(const char* _pathOut)
 
 uint32_t KtxImage::getWidth() const
 {
-	assert(((void)"Ktx texture must be initialized", m_ktxTexture == nullptr));
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
 	return m_ktxTexture->baseWidth;
 }
 
 uint32_t KtxImage::getHeight() const
 {
-	assert(((void)"Ktx texture must be initialized", m_ktxTexture == nullptr));
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
 	return m_ktxTexture->baseHeight;
 }
 
 uint32_t KtxImage::getLevels() const
 {
-	assert(((void)"Ktx texture must be initialized", m_ktxTexture == nullptr));
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
 	return m_ktxTexture->numLevels;
 }
 
 bool KtxImage::isCubeMap() const
 {
-	assert(((void)"Ktx texture must be initialized", m_ktxTexture == nullptr));
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
 	return m_ktxTexture->numFaces == 6u;
 }
 
 VkFormat KtxImage::getFormat() const
 {
-	assert(((void)"Ktx texture must be initialized", m_ktxTexture == nullptr));
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
 	return static_cast<VkFormat>(m_ktxTexture->vkFormat);
 }
+
+bool KtxImage::needsTranscoding() const
+{
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
+	return ktxTexture2_NeedsTranscoding(m_ktxTexture);
+}
+
+size_t KtxImage::getHostByteSize() const
+{
+	if (m_ktxTexture == nullptr || m_ktxTexture->pData == nullptr)
+	{
+		return 0u;
+	}
+
+	return ktxTexture_GetDataSize(ktxTexture(m_ktxTexture));
+}
+
+const uint8_t* KtxImage::getImageData(uint32_t _level, uint32_t _face, size_t& _outByteSize) const
+{
+	assert(((void)"Ktx texture must be initialized", m_ktxTexture != nullptr));
+
+	if (_level >= m_ktxTexture->numLevels || _face >= m_ktxTexture->numFaces)
+	{
+		return nullptr;
+	}
+
+	const ktx_size_t imageSize = ktxTexture_GetImageSize(ktxTexture(m_ktxTexture), _level);
+
+	// created or inflated by libktx
+	if (m_ktxTexture->pData != nullptr)
+	{
+		ktx_size_t offset = 0u;
+		if (ktxTexture_GetImageOffset(ktxTexture(m_ktxTexture), _level, 0u, _face, &offset) != KTX_SUCCESS)
+		{
+			return nullptr;
+		}
+
+		_outByteSize = imageSize;
+		return ktxTexture_GetData(ktxTexture(m_ktxTexture)) + offset;
+	}
+
+	// the level index follows the 80 byte header, each entry holds byteOffset, byteLength and uncompressedByteLength
+	const size_t entryOffset = 80u + static_cast<size_t>(_level) * 3u * sizeof(uint64_t);
+	if (entryOffset + 2u * sizeof(uint64_t) > m_file.getSize())
+	{
+		return nullptr;
+	}
+
+	uint64_t levelOffset = 0u;
+	uint64_t levelByteSize = 0u;
+	memcpy(&levelOffset, m_file.getData() + entryOffset, sizeof(uint64_t));
+	memcpy(&levelByteSize, m_file.getData() + entryOffset + sizeof(uint64_t), sizeof(uint64_t));
+
+	// faces of a level are stored one after another
+	const uint64_t faceOffset = static_cast<uint64_t>(_face) * imageSize;
+	if (faceOffset + imageSize > levelByteSize || levelOffset + levelByteSize > m_file.getSize())
+	{
+		return nullptr;
+	}
+
+	_outByteSize = imageSize;
+	return m_file.getData() + levelOffset + faceOffset;
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include "ResultType.h"
+#include "FileHelper.h"
 
 struct ktxTexture2;
 
@@ -13,13 +14,22 @@ namespace IBLLib
 	public:
 		// use this constructor if you want to load a ktx file
 		KtxImage();
-		// use this constructor if you want to create a ktx file
-		KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32_t _levels, bool _isCubeMap);
+		// use this constructor if you want to create a ktx file, more than one layer creates an array texture
+		KtxImage(uint32_t _width, uint32_t _height, VkFormat _vkFormat, uint32_t _levels, bool _isCubeMap, uint32_t _layers = 1u);
 		~KtxImage();
 
+		// checks the KTX 2.0 identifier without loading the file
+		static bool isKtx2File(const char* _pFilePath);
+
+		// the file is mapped, image data without supercompression is read from the mapping instead of being copied
 		Result loadKtx2(const char* _pFilePath);
 
 		Result writeFace(const std::vector<uint8_t>& _inData, uint32_t _side, uint32_t _level);
+
+		// storage of a created texture (nullptr if creation failed), faces can be written in place at getFaceOffset
+		// instead of going through writeFace
+		uint8_t* getStorage(size_t& _outByteSize);
+		Result getFaceOffset(uint32_t _side, uint32_t _level, uint32_t _layer, size_t& _outOffset) const;
 		Result save(const char* _pathOut);
 
 		uint32_t getWidth() const;
@@ -28,8 +38,18 @@ namespace IBLLib
 		bool isCubeMap() const;
 		VkFormat getFormat() const;
 
+		// basis compressed textures have to be transcoded before their data can be used
+		bool needsTranscoding() const;
+
+		// tightly packed rows of one face of a loaded texture, nullptr if the image does not exist
+		const uint8_t* getImageData(uint32_t _level, uint32_t _face, size_t& _outByteSize) const;
+
+		// image data allocated by libktx (created or inflated textures), 0 if it is read from the file mapping
+		size_t getHostByteSize() const;
+
 	private:
 		ktxTexture2* m_ktxTexture = nullptr;
+		MappedFile m_file;
 	};
 
 } // !IBLLIb
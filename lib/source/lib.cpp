@@ -1,18 +1,69 @@
 #include "GltfIblSampler.h"
 #include "vkHelper.h"
-#include "ShaderCompiler.h"
 #include "STBImage.h"
+#include "HdrReader.h"
+#include "ExrReader.h"
+#include "FilterParameters.h"
+#include "ThreadPool.h"
 #include "FileHelper.h"
 #include "ktxImage.h"
+#include "RenderGraph.h"
+#include "PixelConversion.h"
+#include "Trace.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string>
 //#include <string>
 
 #include "format.h"
 
+#if defined(IBLSAMPLER_RUNTIME_SHADER_COMPILER)
+#include "ShaderCompiler.h"
+#endif
+
 namespace IBLLib
 {
 
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point _start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+}
+
+// image buffers a sample call holds on the host, for Statistics::peakHostBytes
+struct HostMemory
+{
+	void add(size_t _bytes)
+	{
+		liveBytes += _bytes;
+		peakBytes = std::max(peakBytes, liveBytes);
+	}
+
+	void remove(size_t _bytes) { liveBytes -= _bytes; }
+
+	size_t liveBytes = 0u;
+	size_t peakBytes = 0u;
+};
+
+// shader entry points of the sampler, compiled to SPIR-V at build time (see add_spirv_header in CMakeLists.txt).
+// with IBLSAMPLER_RUNTIME_SHADER_COMPILER the GLSL sources are compiled by glslang when they are loaded
+enum class Shader
+{
+	FullscreenVertex,
+	FilterCubeMap,
+	PanoramaToCubeMap,
+	PanoramaRGBEToCubeMap
+};
+
+#if defined(IBLSAMPLER_RUNTIME_SHADER_COMPILER)
+
 constexpr auto filterFragmentShader =
 #include "shaders/filter.frag"
 ;
@@ -21,11 +72,45 @@ constexpr auto primitiveVertexShader =
 #include "shaders/primitive.vert"
 ;
 
-Result compileShader(vkHelper& _vulkan, const char* _shaderText, const char* _entryPoint, VkShaderModule& _outModule, ShaderCompiler::Stage _stage)
+constexpr auto panoramaToCubeMapShader =
+#include "shaders/panoramaToCubeMap.comp"
+;
+
+Result loadShader(vkHelper& _vulkan, Shader _shader, VkShaderModule& _outModule)
 {
+	const char* shaderText = nullptr;
+	const char* entryPoint = nullptr;
+	ShaderCompiler::Stage stage = ShaderCompiler::Stage::Vertex;
+
+	switch (_shader)
+	{
+	case Shader::FullscreenVertex:
+		shaderText = primitiveVertexShader;
+		entryPoint = "main";
+		stage = ShaderCompiler::Stage::Vertex;
+		break;
+	case Shader::FilterCubeMap:
+		shaderText = filterFragmentShader;
+		entryPoint = "filterCubeMap";
+		stage = ShaderCompiler::Stage::Fragment;
+		break;
+	case Shader::PanoramaToCubeMap:
+		shaderText = panoramaToCubeMapShader;
+		entryPoint = "panoramaToCubeMap";
+		stage = ShaderCompiler::Stage::Compute;
+		break;
+	case Shader::PanoramaRGBEToCubeMap:
+		shaderText = panoramaToCubeMapShader;
+		entryPoint = "panoramaRGBEToCubeMap";
+		stage = ShaderCompiler::Stage::Compute;
+		break;
+	default:
+		return Result::InvalidArgument;
+	}
+
 	std::vector<uint32_t> outSpvBlob;
 
-	if (ShaderCompiler::instance().compile(_shaderText, _entryPoint, _stage, outSpvBlob) == false)
+	if (ShaderCompiler::instance().compile(shaderText, entryPoint, stage, outSpvBlob) == false)
 	{
 		return Result::ShaderCompilationFailed;
 	}
@@ -38,112 +123,302 @@ Result compileShader(vkHelper& _vulkan, const char* _shaderText, const char* _en
 	return Result::Success;
 }
 
-Result uploadImage(vkHelper& _vulkan, const char* _inputPath, VkImage& _outImage)
+#else
+
+#include "fullscreenVertex.spv.h"
+#include "filterCubeMap.spv.h"
+#include "panoramaToCubeMap.spv.h"
+#include "panoramaRGBEToCubeMap.spv.h"
+
+Result loadShader(vkHelper& _vulkan, Shader _shader, VkShaderModule& _outModule)
 {
-	_outImage = VK_NULL_HANDLE;
-	STBImage panorama;
+	const uint32_t* pSpirv = nullptr;
+	size_t byteSize = 0u;
+
+	switch (_shader)
+	{
+	case Shader::FullscreenVertex:
+		pSpirv = fullscreenVertexSpirv;
+		byteSize = sizeof(fullscreenVertexSpirv);
+		break;
+	case Shader::FilterCubeMap:
+		pSpirv = filterCubeMapSpirv;
+		byteSize = sizeof(filterCubeMapSpirv);
+		break;
+	case Shader::PanoramaToCubeMap:
+		pSpirv = panoramaToCubeMapSpirv;
+		byteSize = sizeof(panoramaToCubeMapSpirv);
+		break;
+	case Shader::PanoramaRGBEToCubeMap:
+		pSpirv = panoramaRGBEToCubeMapSpirv;
+		byteSize = sizeof(panoramaRGBEToCubeMapSpirv);
+		break;
+	default:
+		return Result::InvalidArgument;
+	}
 
-	if (panorama.loadHdr(_inputPath) != Result::Success)
+	if (_vulkan.loadShaderModule(_outModule, pSpirv, byteSize) != VK_SUCCESS)
 	{
-		return Result::InputPanoramaFileNotFound;
+		return Result::VulkanError;
 	}
 
-	VkCommandBuffer uploadCmds = VK_NULL_HANDLE;
-	if (_vulkan.createCommandBuffer(uploadCmds) != VK_SUCCESS)
+	return Result::Success;
+}
+
+#endif // !IBLSAMPLER_RUNTIME_SHADER_COMPILER
+
+// smallest format that can be sampled with linear filtering, the panorama is converted while uploading
+VkFormat selectPanoramaFormat(const vkHelper& _vulkan)
+{
+	const VkFormat candidates[] =
+	{
+		VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,
+		VK_FORMAT_R16G16B16A16_SFLOAT,
+	};
+
+	const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	for (const VkFormat format : candidates)
 	{
-		return Result::VulkanError;
+		if (_vulkan.isFormatSupported(format, features))
+		{
+			return format;
+		}
 	}
 
-	// create staging buffer for image data
-	VkBuffer stagingBuffer = VK_NULL_HANDLE;
-	if (_vulkan.createBufferAndAllocate(stagingBuffer, static_cast<uint32_t>(panorama.getByteSize()), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != VK_SUCCESS)
+	return VK_FORMAT_R32G32B32A32_SFLOAT;
+}
+
+// radiance files are decoded scanline by scanline while uploading, OpenEXR files are decoded to half floats,
+// other formats are loaded through stb. KTX2 cube maps are uploaded as they are and skip the panorama conversion
+enum class InputSource { Radiance, OpenEXR, STB, CubeMap };
+
+// one environment of a sample call, a batch packs them into the layers of the same images
+struct InputImage
+{
+	HdrReader hdrReader;
+	ExrReader exrReader;
+	STBImage panorama;
+	KtxImage cubeMap;
+	InputSource source = InputSource::STB;
+	uint32_t width = 0u; // of the panorama or the cube map faces
+	uint32_t height = 0u;
+	VkFormat format = VK_FORMAT_UNDEFINED; // the panorama is converted to it while uploading
+};
+
+// opens or decodes _path and selects the format it is uploaded in
+Result loadInput(const vkHelper& _vulkan, const char* _path, InputImage& _input)
+{
+	if (_input.hdrReader.open(_path) == Result::Success)
 	{
-		return Result::VulkanError;
+		// radiance texels are uploaded as they are stored (4 bytes, lossless) and decoded on the GPU
+		_input.source = InputSource::Radiance;
+		_input.width = _input.hdrReader.getWidth();
+		_input.height = _input.hdrReader.getHeight();
+		_input.format = VK_FORMAT_R8G8B8A8_UINT;
+	}
+	else if (ExrReader::isExrFile(_path))
+	{
+		Result res = _input.exrReader.load(_path);
+		if (res != Result::Success)
+		{
+			return res;
+		}
+
+		_input.source = InputSource::OpenEXR;
+		_input.width = _input.exrReader.getWidth();
+		_input.height = _input.exrReader.getHeight();
+		_input.format = VK_FORMAT_R16G16B16A16_SFLOAT;
 	}
+	else if (KtxImage::isKtx2File(_path))
+	{
+		Result res = _input.cubeMap.loadKtx2(_path);
+		if (res != Result::Success)
+		{
+			return res;
+		}
+
+		if (_input.cubeMap.isCubeMap() == false || _input.cubeMap.getWidth() != _input.cubeMap.getHeight() || _input.cubeMap.needsTranscoding())
+		{
+			printf("Input %s has to be an uncompressed square cube map\n", _path);
+			return Result::InvalidArgument;
+		}
 
-	// transfer data to the host coherent staging buffer
-	if (_vulkan.writeBufferData(stagingBuffer, panorama.getHdrData(), panorama.getByteSize()) != VK_SUCCESS)
+		// the input cube map is filtered in the format of the file
+		_input.source = InputSource::CubeMap;
+		_input.width = _input.cubeMap.getWidth();
+		_input.height = _input.cubeMap.getHeight();
+		_input.format = _input.cubeMap.getFormat();
+	}
+	else
 	{
-		return Result::VulkanError;
+		// 8 bit images stay 8 bit on the GPU instead of being expanded to float
+		const Result loadResult = STBImage::isHdrFile(_path) ? _input.panorama.loadHdr(_path) : _input.panorama.loadPng(_path);
+
+		if (loadResult != Result::Success)
+		{
+			return Result::InputPanoramaFileNotFound;
+		}
+
+		_input.source = InputSource::STB;
+		_input.width = static_cast<uint32_t>(_input.panorama.getWidth());
+		_input.height = static_cast<uint32_t>(_input.panorama.getHeight());
+		_input.format = _input.panorama.isHdr() ? selectPanoramaFormat(_vulkan) : VK_FORMAT_R8G8B8A8_SRGB;
 	}
 
-	// create the destination image we want to sample in the shader
-	if (_vulkan.createImage2DAndAllocate(_outImage, panorama.getWidth(), panorama.getHeight(), VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != VK_SUCCESS)
+	return Result::Success;
+}
+
+// converts rows of the decoded panorama to _format
+bool writePanoramaRows(const STBImage& _panorama, VkFormat _format, uint32_t _firstRow, uint32_t _rowCount, void* _dst)
+{
+	const size_t width = static_cast<size_t>(_panorama.getWidth());
+	const size_t srcRowPitch = width * 4u;
+	const size_t dstRowPitch = width * getFormatSize(_format);
+
+	// 8 bit images are copied as they are, the sampler does the sRGB decode
+	if (_panorama.isHdr() == false)
 	{
-		return Result::VulkanError;
+		if (_format != VK_FORMAT_R8G8B8A8_SRGB || dstRowPitch != srcRowPitch)
+		{
+			return false;
+		}
+
+		memcpy(_dst, _panorama.getByteData() + _firstRow * srcRowPitch, _rowCount * srcRowPitch);
+		return true;
 	}
 
-	if (_vulkan.beginCommandBuffer(uploadCmds, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
+	const float* pData = _panorama.getHdrData();
+	uint8_t* pDst = static_cast<uint8_t*>(_dst);
+
+	for (uint32_t row = 0u; row < _rowCount; ++row)
 	{
-		return Result::VulkanError;
+		if (convertRGBA32F(pData + (_firstRow + row) * srcRowPitch, pDst + row * dstRowPitch, width, _format) == false)
+		{
+			return false;
+		}
 	}
 
-	// transition to write dst layout
-	_vulkan.transitionImageToTransferWrite(uploadCmds, _outImage);
-	_vulkan.copyBufferToBasicImage2D(uploadCmds, stagingBuffer, _outImage);
-	_vulkan.transitionImageToShaderRead(uploadCmds, _outImage);
+	return true;
+}
+
+// streams the panoramas of _inputs into the layers of _image through a small ring of staging buffers, leaves _image in
+// TRANSFER_DST_OPTIMAL. the rows are decoded on _pool and converted to the format of _image while filling the staging buffers
+Result uploadPanoramas(vkHelper& _vulkan, const std::vector<std::unique_ptr<InputImage>>& _inputs, ThreadPool& _pool, const VkImage _image)
+{
+	TraceZone zone("uploadPanoramas");
+
+	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_image);
 
-	if (_vulkan.endCommandBuffer(uploadCmds) != VK_SUCCESS)
+	if (pInfo == nullptr || pInfo->arrayLayers != _inputs.size())
 	{
-		return Result::VulkanError;
+		return Result::InvalidArgument;
 	}
 
-	if (_vulkan.executeCommandBuffer(uploadCmds) != VK_SUCCESS)
+	const VkFormat format = pInfo->format;
+
+	for (const std::unique_ptr<InputImage>& input : _inputs)
 	{
-		return Result::VulkanError;
+		if (input->source == InputSource::CubeMap || input->format != format ||
+			input->width != pInfo->extent.width || input->height != pInfo->extent.height)
+		{
+			return Result::InvalidArgument;
+		}
 	}
 
-	_vulkan.destroyBuffer(stagingBuffer);
-	_vulkan.destroyCommandBuffer(uploadCmds);
+	const auto writeRows = [&](uint32_t /*_level*/, uint32_t _layer, uint32_t _firstRow, uint32_t _rowCount, void* _dst) -> bool
+	{
+		InputImage& input = *_inputs[_layer];
+
+		switch (input.source)
+		{
+		case InputSource::Radiance:
+			// chunks are written in order, the reader can not seek
+			return _firstRow == input.hdrReader.getCurrentRow() && input.hdrReader.readScanlines(_rowCount, _dst, format, _pool) == Result::Success;
+		case InputSource::OpenEXR:
+			// the half float channels are interleaved
+			return input.exrReader.readRows(_firstRow, _rowCount, static_cast<uint16_t*>(_dst), _pool) == Result::Success;
+		default:
+			return writePanoramaRows(input.panorama, format, _firstRow, _rowCount, _dst);
+		}
+	};
+
+	// layer by layer, every reader sees its rows in order
+	if (_vulkan.uploadMipChainStreamed(_image, writeRows, 1u) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
 
 	return Result::Success;
 }
 
-Result convertVkFormat(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, const VkImage _srcImage, VkImage& _outImage, VkFormat _dstFormat, const VkImageLayout inputImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+// copies the faces of mip levels [0, _levelCount) of the cube maps of _inputs into _image, cube map i to the layers
+// [6i, 6i + 6). leaves _image in TRANSFER_DST_OPTIMAL
+Result uploadCubeMaps(vkHelper& _vulkan, const std::vector<std::unique_ptr<InputImage>>& _inputs, uint32_t _levelCount, const VkImage _image)
 {
-	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
+	TraceZone zone("uploadCubeMaps");
 
-	if (pInfo == nullptr)
+	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_image);
+
+	if (pInfo == nullptr || pInfo->arrayLayers != 6u * _inputs.size())
 	{
 		return Result::InvalidArgument;
 	}
 
-	if (_outImage != VK_NULL_HANDLE)
+	for (const std::unique_ptr<InputImage>& input : _inputs)
 	{
-		printf("Expecting empty outImage\n");
-		return Result::InvalidArgument;
+		const KtxImage& cubeMap = input->cubeMap;
+
+		if (input->source != InputSource::CubeMap || cubeMap.getFormat() != pInfo->format ||
+			cubeMap.getWidth() != pInfo->extent.width || _levelCount > cubeMap.getLevels())
+		{
+			return Result::InvalidArgument;
+		}
 	}
 
-	const VkFormat srcFormat = pInfo->format;
-	const uint32_t sideLength = pInfo->extent.width;
-	const uint32_t mipLevels = pInfo->mipLevels;
-	const uint32_t arrayLayers = pInfo->arrayLayers;
+	const size_t texelSize = getFormatSize(pInfo->format);
 
-	if (_vulkan.createImage2DAndAllocate(_outImage, sideLength, sideLength, _dstFormat,
-																			 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-																			 mipLevels, arrayLayers, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE) != VK_SUCCESS)
+	const auto writeRows = [&](uint32_t _level, uint32_t _layer, uint32_t _firstRow, uint32_t _rowCount, void* _dst) -> bool
+	{
+		const KtxImage& cubeMap = _inputs[_layer / 6u]->cubeMap;
+
+		// ktx2 rows are tightly packed
+		const size_t rowPitch = std::max(1u, cubeMap.getWidth() >> _level) * texelSize;
+
+		size_t byteSize = 0u;
+		const uint8_t* pData = cubeMap.getImageData(_level, _layer % 6u, byteSize);
+
+		if (pData == nullptr || (_firstRow + _rowCount) * rowPitch > byteSize)
+		{
+			return false;
+		}
+
+		memcpy(_dst, pData + _firstRow * rowPitch, _rowCount * rowPitch);
+		return true;
+	};
+
+	if (_vulkan.uploadMipChainStreamed(_image, writeRows, _levelCount) != VK_SUCCESS)
 	{
 		return Result::VulkanError;
 	}
 
-	VkImageSubresourceRange subresourceRange{};
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	subresourceRange.baseMipLevel = 0;
-	subresourceRange.levelCount = mipLevels;
-	subresourceRange.layerCount = arrayLayers;
-	
-	_vulkan.imageBarrier(_commandBuffer, _outImage,
-											 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-											 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,//src stage, access
-											 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,//dst stage, access
-											 subresourceRange);
-
-	_vulkan.imageBarrier(_commandBuffer, _srcImage,
-											 inputImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-											 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,//src stage, access
-											 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,//dst stage, access
-											 subresourceRange);
-	
+	return Result::Success;
+}
+
+// expects _srcImage in TRANSFER_SRC_OPTIMAL and _dstImage in TRANSFER_DST_OPTIMAL
+Result convertVkFormat(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, const VkImage _srcImage, const VkImage _dstImage)
+{
+	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
+
+	if (pInfo == nullptr || _vulkan.getCreateInfo(_dstImage) == nullptr)
+	{
+		return Result::InvalidArgument;
+	}
+
+	const uint32_t sideLength = pInfo->extent.width;
+	const uint32_t mipLevels = pInfo->mipLevels;
+	const uint32_t arrayLayers = pInfo->arrayLayers;
+
 	uint32_t currentSideLength = sideLength;
 
 	for (uint32_t level = 0; level < mipLevels; level++)
@@ -170,7 +445,7 @@ Result convertVkFormat(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer,
 									 _commandBuffer,
 									 _srcImage,
 									 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-									 _outImage,
+									 _dstImage,
 									 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 									 1,
 									 &imageBlit,
@@ -182,7 +457,30 @@ Result convertVkFormat(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer,
 	return Result::Success;
 }
 
-Result downloadCubemap(vkHelper& _vulkan, const VkImage _srcImage, const char* _outputPath, const VkImageLayout inputImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+// copy of an output image into a host visible staging buffer. it is submitted right behind the render graph and
+// read once the copy completed, the queue goes from the last pass to the copy without waiting for the CPU
+struct Readback
+{
+	explicit Readback(vkHelper& _vulkan) : vulkan(_vulkan), stagingBuffer(_vulkan) {}
+
+	// the copy is still running if the sample call failed before finishReadback
+	~Readback()
+	{
+		if (fence != VK_NULL_HANDLE)
+		{
+			vulkan.waitForSubmission(fence);
+		}
+	}
+
+	vkHelper& vulkan;
+	UniqueBuffer stagingBuffer;
+	VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	size_t byteSize = 0u;
+};
+
+// _inputImageLayout is the layout the graph leaves _srcImage in
+Result submitReadback(vkHelper& _vulkan, const VkImage _srcImage, const VkImageLayout _inputImageLayout, const std::vector<VkBufferImageCopy>& _regions, size_t _byteSize, Readback& _readback)
 {
 	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
 	if (pInfo == nullptr)
@@ -190,68 +488,106 @@ Result downloadCubemap(vkHelper& _vulkan, const VkImage _srcImage, const char* _
 		return Result::InvalidArgument;
 	}
 
-	Result res = Success;
-
-	const VkFormat cubeMapFormat = pInfo->format;
-	const uint32_t cubeMapFormatByteSize = getFormatSize(cubeMapFormat);
-	const uint32_t cubeMapSideLength = pInfo->extent.width;
-	const uint32_t mipLevels = pInfo->mipLevels;
+	_readback.byteSize = _byteSize;
 
-	using Faces = std::vector<VkBuffer>;
-	using MipLevels = std::vector<Faces>;
+	if (_vulkan.createBufferAndAllocate(_readback.stagingBuffer.out(), _byteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
 
-	MipLevels stagingBuffer(mipLevels);
+	if (_vulkan.createCommandBuffer(_readback.cmdBuffer) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
 
+	if (_vulkan.beginCommandBuffer(_readback.cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
 	{
-		uint32_t currentSideLength = cubeMapSideLength;
+		return Result::VulkanError;
+	}
 
-		for (uint32_t level = 0; level < mipLevels; level++)
-		{
-			Faces& faces = stagingBuffer[level];
-			faces.resize(6u);
+	// barrier on complete image. the last pass writing it may be a render pass, a compute dispatch or a blit and
+	// is still executing
+	_vulkan.imageBarrier(_readback.cmdBuffer, _srcImage,
+											 _inputImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+											 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT, // src stage, access
+											 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+											 { VK_IMAGE_ASPECT_COLOR_BIT, 0u, pInfo->mipLevels, 0u, pInfo->arrayLayers });//dst stage, access
 
-			for (uint32_t face = 0; face < 6u; face++)
-			{
-				if (_vulkan.createBufferAndAllocate(
-																						faces[face], currentSideLength * currentSideLength * cubeMapFormatByteSize,
-																						VK_BUFFER_USAGE_TRANSFER_DST_BIT,// VkBufferUsageFlags _usage,
-																						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)//VkMemoryPropertyFlags _memoryFlags,
-						!= VK_SUCCESS)
-				{
-					return Result::VulkanError;
-				}
-			}
+	for (const VkBufferImageCopy& region : _regions)
+	{
+		_vulkan.copyImage2DToBuffer(_readback.cmdBuffer, _srcImage, _readback.stagingBuffer, region);
+	}
 
-			currentSideLength = currentSideLength >> 1;
-		}
+	if (_vulkan.endCommandBuffer(_readback.cmdBuffer) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
+
+	if (_vulkan.submitCommandBuffers({ _readback.cmdBuffer }, _readback.fence) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
 	}
 
-	VkCommandBuffer downloadCmds = VK_NULL_HANDLE;
-	if (_vulkan.createCommandBuffer(downloadCmds) != VK_SUCCESS)
+	return Result::Success;
+}
+
+// waits for the copy and reads the staging buffer into _dst
+Result finishReadback(vkHelper& _vulkan, Readback& _readback, void* _dst)
+{
+	if (_readback.fence == VK_NULL_HANDLE || _vulkan.waitForSubmission(_readback.fence) != VK_SUCCESS)
 	{
 		return Result::VulkanError;
 	}
 
-	if (_vulkan.beginCommandBuffer(downloadCmds, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
+	_readback.fence = VK_NULL_HANDLE;
+	_vulkan.destroyCommandBuffer(_readback.cmdBuffer);
+	_readback.cmdBuffer = VK_NULL_HANDLE;
+
+	if (_vulkan.readBufferData(_readback.stagingBuffer, _dst, _readback.byteSize) != VK_SUCCESS)
 	{
 		return Result::VulkanError;
 	}
 
-	// barrier on complete image
-	VkImageSubresourceRange  subresourceRange{};
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	subresourceRange.baseArrayLayer = 0u;
-	subresourceRange.layerCount = 6u;
-	subresourceRange.baseMipLevel = 0u;
-	subresourceRange.levelCount = mipLevels;
+	_readback.stagingBuffer.reset();
 
-	_vulkan.imageBarrier(downloadCmds, _srcImage,
-											 inputImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-											 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // src stage, access
-											 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
-											 subresourceRange);//dst stage, access
+	return Result::Success;
+}
+
+// reads back the cube maps [_firstCube, _firstCube + _cubeCount) of _srcImage into a ktx texture, a cube map array
+// if there is more than one
+Result submitCubeMapDownload(vkHelper& _vulkan, const VkImage _srcImage, const VkImageLayout _inputImageLayout, uint32_t _firstCube, uint32_t _cubeCount, std::unique_ptr<KtxImage>& _outKtxImage, Readback& _readback, Statistics& _statistics, HostMemory& _hostMemory)
+{
+	TraceZone zone("submitCubeMapDownload");
+
+	const Clock::time_point start = Clock::now();
+
+	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
+	if (pInfo == nullptr || _cubeCount == 0u || 6u * (_firstCube + _cubeCount) > pInfo->arrayLayers)
+	{
+		return Result::InvalidArgument;
+	}
 
-	// copy all faces & levels into staging buffers
+	Result res = Success;
+
+	const VkFormat cubeMapFormat = pInfo->format;
+	const uint32_t cubeMapSideLength = pInfo->extent.width;
+	const uint32_t mipLevels = pInfo->mipLevels;
+
+	_outKtxImage.reset(new KtxImage(cubeMapSideLength, cubeMapSideLength, cubeMapFormat, mipLevels, true, _cubeCount));
+
+	// the staging buffer has the layout of the ktx storage, faces are copied to their final offsets by the GPU
+	// and read back with a single copy straight into the texture
+	size_t storageByteSize = 0u;
+	if (_outKtxImage->getStorage(storageByteSize) == nullptr)
+	{
+		return Result::KtxError;
+	}
+
+	_hostMemory.add(_outKtxImage->getHostByteSize());
+
+	// copy all faces & levels of the cube maps into the staging buffer
+	std::vector<VkBufferImageCopy> regions;
 	{
 		uint32_t currentSideLength = cubeMapSideLength;
 
@@ -263,81 +599,104 @@ Result downloadCubemap(vkHelper& _vulkan, const VkImage _srcImage, const char* _
 		for (uint32_t level = 0; level < mipLevels; level++)
 		{
 			region.imageSubresource.mipLevel = level;
-			Faces& faces = stagingBuffer[level];
 
-			for (uint32_t face = 0; face < 6u; face++)
+			for (uint32_t cube = 0; cube < _cubeCount; cube++)
 			{
-				region.imageSubresource.baseArrayLayer = face;
-				region.imageExtent = { currentSideLength , currentSideLength , 1u };
+				for (uint32_t face = 0; face < 6u; face++)
+				{
+					size_t offset = 0u;
+					if ((res = _outKtxImage->getFaceOffset(face, level, cube, offset)) != Result::Success)
+					{
+						return res;
+					}
 
-				_vulkan.copyImage2DToBuffer(downloadCmds, _srcImage, faces[face], region);
+					region.bufferOffset = offset;
+					region.imageSubresource.baseArrayLayer = 6u * (_firstCube + cube) + face;
+					region.imageExtent = { currentSideLength , currentSideLength , 1u };
+
+					regions.push_back(region);
+				}
 			}
 
 			currentSideLength = currentSideLength >> 1;
 		}
 	}
 
-	if (_vulkan.endCommandBuffer(downloadCmds) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
+	res = submitReadback(_vulkan, _srcImage, _inputImageLayout, regions, storageByteSize, _readback);
+
+	_statistics.readback += millisecondsSince(start);
+
+	return res;
+}
+
+Result finishCubeMapDownload(vkHelper& _vulkan, KtxImage& _ktxImage, Readback& _readback, const char* _outputPath, Statistics& _statistics, HostMemory& _hostMemory)
+{
+	TraceZone zone("finishCubeMapDownload");
+
+	const Clock::time_point start = Clock::now();
 
-	if (_vulkan.executeCommandBuffer(downloadCmds) != VK_SUCCESS)
+	// Image is copied to buffer
+	// Now map buffer and copy to the ktx storage
+	size_t storageByteSize = 0u;
+	Result res = finishReadback(_vulkan, _readback, _ktxImage.getStorage(storageByteSize));
+	if (res != Result::Success)
 	{
-		return Result::VulkanError;
+		return res;
 	}
 
-	_vulkan.destroyCommandBuffer(downloadCmds);
+	_statistics.readback += millisecondsSince(start);
+	const Clock::time_point writeStart = Clock::now();
 
-	// Image is copied to buffer
-	// Now map buffer and copy to ram
+	res = _ktxImage.save(_outputPath);
+	if (res != Result::Success)
 	{
-		KtxImage ktxImage(cubeMapSideLength, cubeMapSideLength, cubeMapFormat, mipLevels, true);
+		printf("Could not save to path %s \n", _outputPath);
+		return res;
+	}
 
-		std::vector<uint8_t> imageData;
+	_statistics.write += millisecondsSince(writeStart);
+	_hostMemory.remove(_ktxImage.getHostByteSize());
 
-		uint32_t currentSideLength = cubeMapSideLength;
+	return Result::Success;
+}
 
-		for (uint32_t level = 0; level < mipLevels; level++)
-		{
-			const size_t imageByteSize = (size_t)currentSideLength * (size_t)currentSideLength * (size_t)cubeMapFormatByteSize;
-			imageData.resize(imageByteSize);
+Result submit2DImageDownload(vkHelper& _vulkan, const VkImage _srcImage, const VkImageLayout _inputImageLayout, Readback& _readback, Statistics& _statistics)
+{
+	TraceZone zone("submit2DImageDownload");
 
-			Faces& faces = stagingBuffer[level];
+	const Clock::time_point start = Clock::now();
 
-			for (uint32_t face = 0; face < 6u; face++)
-			{
-				if (_vulkan.readBufferData(faces[face], imageData.data(), imageByteSize) != VK_SUCCESS)
-				{
-					return Result::VulkanError;
-				}
+	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
+	if (pInfo == nullptr)
+	{
+		return Result::InvalidArgument;
+	}
 
-				res = ktxImage.writeFace(imageData, face, level);
+	const uint32_t formatByteSize = getFormatSize(pInfo->format);
+	const size_t imageByteSize = static_cast<size_t>(pInfo->extent.width) * pInfo->extent.height * formatByteSize;
 
-				if (res != Result::Success)
-				{
-					return res;
-				}
+	// copy 2D image to buffer
+	VkBufferImageCopy region{};
 
-				_vulkan.destroyBuffer(faces[face]);
-			}
+	region.imageExtent = pInfo->extent;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1u;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
 
-			currentSideLength = currentSideLength >> 1;
-		}
+	const Result res = submitReadback(_vulkan, _srcImage, _inputImageLayout, { region }, imageByteSize, _readback);
 
-		res = ktxImage.save(_outputPath);
-		if (res != Result::Success)
-		{
-			printf("Could not save to path %s \n", _outputPath);
-			return res;
-		}
-	}
+	_statistics.readback += millisecondsSince(start);
 
-	return Result::Success;
+	return res;
 }
 
-Result download2DImage(vkHelper& _vulkan, const VkImage _srcImage, const char* _outputPath, const VkImageLayout inputImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+Result finish2DImageDownload(vkHelper& _vulkan, const VkImage _srcImage, Readback& _readback, const char* _outputPath, Statistics& _statistics, HostMemory& _hostMemory)
 {
+	TraceZone zone("finish2DImageDownload");
+
+	const Clock::time_point start = Clock::now();
+
 	const VkImageCreateInfo* pInfo = _vulkan.getCreateInfo(_srcImage);
 	if (pInfo == nullptr)
 	{
@@ -346,85 +705,25 @@ Result download2DImage(vkHelper& _vulkan, const VkImage _srcImage, const char* _
 
 	Result res = Success;
 
-	const VkFormat format = pInfo->format;
-	const uint32_t formatByteSize = getFormatSize(format);
 	const uint32_t width = pInfo->extent.width;
 	const uint32_t height = pInfo->extent.width;
-	const size_t imageByteSize = width * height * formatByteSize;
-
-	VkBuffer stagingBuffer{};
-
-	if (_vulkan.createBufferAndAllocate(
-																			stagingBuffer, static_cast<uint32_t>(imageByteSize),
-																			VK_BUFFER_USAGE_TRANSFER_DST_BIT,// VkBufferUsageFlags _usage,
-																			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)//VkMemoryPropertyFlags _memoryFlags,
-			!= VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
-
-	VkCommandBuffer downloadCmds = VK_NULL_HANDLE;
-	if (_vulkan.createCommandBuffer(downloadCmds) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
-
-	if (_vulkan.beginCommandBuffer(downloadCmds, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
-
-	// barrier on complete image
-	VkImageSubresourceRange  subresourceRange{};
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	subresourceRange.baseArrayLayer = 0u;
-	subresourceRange.layerCount = 1u;
-	subresourceRange.baseMipLevel = 0u;
-	subresourceRange.levelCount = 1u;
-
-	_vulkan.imageBarrier(downloadCmds, _srcImage,
-											 inputImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-											 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // src stage, access
-											 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
-											 subresourceRange);//dst stage, access
-
-	// copy 2D image to buffer
-	{
-		VkBufferImageCopy region{};
-
-		region.imageExtent = pInfo->extent;
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.layerCount = 1u;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-
-		_vulkan.copyImage2DToBuffer(downloadCmds, _srcImage, stagingBuffer, region);
-	}
-
-	if (_vulkan.endCommandBuffer(downloadCmds) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
-
-	if (_vulkan.executeCommandBuffer(downloadCmds) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
-
-	_vulkan.destroyCommandBuffer(downloadCmds);
 
 	// Image is copied to buffer
 	// Now map buffer and copy to ram
 	{
 
 		std::vector<uint8_t> imageData;
-		imageData.resize(imageByteSize);
+		imageData.resize(_readback.byteSize);
+		_hostMemory.add(imageData.size());
 
-		if (_vulkan.readBufferData(stagingBuffer, imageData.data(), imageByteSize) != VK_SUCCESS)
+		if ((res = finishReadback(_vulkan, _readback, imageData.data())) != Result::Success)
 		{
-			return Result::VulkanError;
+			return res;
 		}
 
+		_statistics.readback += millisecondsSince(start);
+		const Clock::time_point writeStart = Clock::now();
+
 		// Compute channel count by dividing the pixel byte length through each channels byte length.
 		const uint32_t channels = getChannelCount(pInfo->format);
 
@@ -435,6 +734,7 @@ Result download2DImage(vkHelper& _vulkan, const VkImage _srcImage, const char* _
 		// which makes is impossible to compare the outputted LUT with already
 		// existing LUT PNGs.
 		std::vector<uint8_t> imageDataThreeChannel(imageData.size() * (4 / channels), 0);
+		_hostMemory.add(imageDataThreeChannel.size());
 		for (uint32_t x = 0; x < width; x++) {
 			for (uint32_t y = 0; y < height; y++) {
 				for (uint32_t c = 0; c < std::min(channels, 3u); c++) {
@@ -451,35 +751,23 @@ Result download2DImage(vkHelper& _vulkan, const VkImage _srcImage, const char* _
 			return res;
 		}
 
-		_vulkan.destroyBuffer(stagingBuffer);
+		_statistics.write += millisecondsSince(writeStart);
+		_hostMemory.remove(imageData.size() + imageDataThreeChannel.size());
 	}
 
 	return Result::Success;
 }
 
-void generateMipmapLevels(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, const VkImage _image, uint32_t _maxMipLevels, uint32_t _sideLength, const VkImageLayout _currentImageLayout)
+// expects all levels in TRANSFER_SRC_OPTIMAL and leaves them there. every blit covers all _layerCount layers
+void generateMipmapLevels(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, const VkImage _image, uint32_t _maxMipLevels, uint32_t _sideLength, uint32_t _layerCount)
 {
-	{
-		VkImageSubresourceRange mipbaseRange{};
-		mipbaseRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		mipbaseRange.baseMipLevel = 0u;
-		mipbaseRange.levelCount = 1u;
-		mipbaseRange.layerCount = 6u;
-
-		_vulkan.imageBarrier(_commandBuffer, _image,
-												 _currentImageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-												 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-												 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,//dst stage, access
-												 mipbaseRange);
-	}
-
 	for (uint32_t i = 1; i < _maxMipLevels; i++)
 	{
 		VkImageBlit imageBlit{};
 
 		// Source
 		imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageBlit.srcSubresource.layerCount = 6u;
+		imageBlit.srcSubresource.layerCount = _layerCount;
 		imageBlit.srcSubresource.mipLevel = i - 1;
 		imageBlit.srcOffsets[1].x = int32_t(_sideLength >> (i - 1));
 		imageBlit.srcOffsets[1].y = int32_t(_sideLength >> (i - 1));
@@ -487,7 +775,7 @@ void generateMipmapLevels(vkHelper& _vulkan, const VkCommandBuffer _commandBuffe
 
 		// Destination
 		imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageBlit.dstSubresource.layerCount = 6u;
+		imageBlit.dstSubresource.layerCount = _layerCount;
 		imageBlit.dstSubresource.mipLevel = i;
 		imageBlit.dstOffsets[1].x = int32_t(_sideLength >> i);
 		imageBlit.dstOffsets[1].y = int32_t(_sideLength >> i);
@@ -497,12 +785,12 @@ void generateMipmapLevels(vkHelper& _vulkan, const VkCommandBuffer _commandBuffe
 		mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		mipSubRange.baseMipLevel = i;
 		mipSubRange.levelCount = 1;
-		mipSubRange.layerCount = 6u;
+		mipSubRange.layerCount = _layerCount;
 
-		//  Transiton current mip level to transfer dest
+		//  Transiton current mip level to transfer dest, its contents are overwritten
 		_vulkan.imageBarrier(_commandBuffer, _image,
-												 _currentImageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-												 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+												 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+												 VK_PIPELINE_STAGE_TRANSFER_BIT, 0u,
 												 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
 												 mipSubRange);//dst stage, access
 
@@ -516,32 +804,19 @@ void generateMipmapLevels(vkHelper& _vulkan, const VkCommandBuffer _commandBuffe
 									 &imageBlit,
 									 VK_FILTER_LINEAR);
 
-
-		//  Transiton  back
+		//  Transiton  back, the next level reads this one
 		_vulkan.imageBarrier(_commandBuffer, _image,
 												 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 												 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
 												 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,//dst stage, access
 												 mipSubRange);
-
-	}
-
-	{
-		VkImageSubresourceRange completeRange{};
-		completeRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		completeRange.baseMipLevel = 0;
-		completeRange.levelCount = _maxMipLevels;
-		completeRange.layerCount = 6u;
-
-		_vulkan.imageBarrier(_commandBuffer, _image,
-												 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-												 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-												 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,//dst stage, access
-												 completeRange);
 	}
 }
 
-Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, /*const VkRenderPass _renderPass,*/ const VkShaderModule fullscreenVertexShader, const VkImage _panoramaImage, const VkImage _cubeMapImage)
+// expects _panoramaImage in SHADER_READ_ONLY_OPTIMAL and _cubeMapImage in GENERAL, writes mip 0 of all faces.
+// panorama layer i becomes the cube map in the layers [6i, 6i + 6), all of them in one dispatch.
+// every cube texel averages a grid of panorama taps sized to the panorama texels it covers, so small cube maps do not alias
+Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer, const VkImage _panoramaImage, const VkImage _cubeMapImage)
 {
 	IBLLib::Result res = Result::Success;
 
@@ -553,34 +828,35 @@ Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer
 	}
 
 	const uint32_t cubeMapSideLength = textureInfo->extent.width;
-	const uint32_t maxMipLevels = textureInfo->mipLevels;
-	const VkFormat format = textureInfo->format;
+	const uint32_t cubeMapLayers = textureInfo->arrayLayers;
+
+	const VkImageCreateInfo* panoramaInfo = _vulkan.getCreateInfo(_panoramaImage);
 
-	VkShaderModule panoramaToCubeMapFragmentShader = VK_NULL_HANDLE;
-	if ((res = compileShader(_vulkan, filterFragmentShader, "panoramaToCubeMap", panoramaToCubeMapFragmentShader, ShaderCompiler::Stage::Fragment)) != Result::Success)
+	if (panoramaInfo == nullptr || cubeMapLayers != 6u * panoramaInfo->arrayLayers)
 	{
-		return res;
+		return Result::InvalidArgument;
 	}
 
-	VkRenderPass renderPass = VK_NULL_HANDLE;
-	{
-		RenderPassDesc renderPassDesc;
+	// raw RGBE texels are decoded and filtered in the shader, unsigned integer formats can not be filtered by the sampler
+	const bool panoramaIsRGBE = panoramaInfo->format == VK_FORMAT_R8G8B8A8_UINT;
+	const char* entryPoint = panoramaIsRGBE ? "panoramaRGBEToCubeMap" : "panoramaToCubeMap";
 
-		// add rendertargets (cubemap faces)
-		for (int face = 0; face < 6; ++face)
-		{
-			renderPassDesc.addAttachment(format);
-		}
-		if (_vulkan.createRenderPass(renderPass, renderPassDesc.getInfo()) != VK_SUCCESS)
-		{
-			return Result::VulkanError;
-		}
+	VkShaderModule panoramaToCubeMapComputeShader = VK_NULL_HANDLE;
+	if ((res = loadShader(_vulkan, panoramaIsRGBE ? Shader::PanoramaRGBEToCubeMap : Shader::PanoramaToCubeMap, panoramaToCubeMapComputeShader)) != Result::Success)
+	{
+		return res;
 	}
 
 	VkSamplerCreateInfo samplerInfo{};
 	_vulkan.fillSamplerCreateInfo(samplerInfo);
 
-	samplerInfo.maxLod = float(maxMipLevels + 1);
+	if (panoramaIsRGBE)
+	{
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	}
+
 	VkSampler panoramaSampler = VK_NULL_HANDLE;
 	if (_vulkan.createSampler(panoramaSampler, samplerInfo) != VK_SUCCESS)
 	{
@@ -588,7 +864,14 @@ Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer
 	}
 
 	VkImageView panoramaImageView = VK_NULL_HANDLE;
-	if (_vulkan.createImageView(panoramaImageView, _panoramaImage) != VK_SUCCESS)
+	if (_vulkan.createImageView(panoramaImageView, _panoramaImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, panoramaInfo->arrayLayers }, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_2D_ARRAY) != VK_SUCCESS)
+	{
+		return Result::VulkanError;
+	}
+
+	// the faces are written as array layers
+	VkImageView cubeMapStorageView = VK_NULL_HANDLE;
+	if (_vulkan.createImageView(cubeMapStorageView, _cubeMapImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, cubeMapLayers }, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_2D_ARRAY) != VK_SUCCESS)
 	{
 		return Result::VulkanError;
 	}
@@ -597,12 +880,11 @@ Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer
 	VkDescriptorSet panoramaSet = VK_NULL_HANDLE;
 	VkPipeline panoramaToCubeMapPipeline = VK_NULL_HANDLE;
 	{
-		//
-		// Create pipeline layout
-		//
 		VkDescriptorSetLayout panoramaSetLayout = VK_NULL_HANDLE;
 		DescriptorSetInfo setLayout0;
-		setLayout0.addCombinedImageSampler(panoramaSampler, panoramaImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// see uPanorama, uCubeMap and uPanoramaRGBE in panoramaToCubeMap.comp
+		setLayout0.addCombinedImageSampler(panoramaSampler, panoramaImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, panoramaIsRGBE ? 2u : 0u, VK_SHADER_STAGE_COMPUTE_BIT);
+		setLayout0.addStorageImage(cubeMapStorageView, VK_IMAGE_LAYOUT_GENERAL, 1u, VK_SHADER_STAGE_COMPUTE_BIT);
 
 		if (setLayout0.create(_vulkan, panoramaSetLayout, panoramaSet) != VK_SUCCESS)
 		{
@@ -616,111 +898,205 @@ Result panoramaToCubemap(vkHelper& _vulkan, const VkCommandBuffer _commandBuffer
 			return Result::VulkanError;
 		}
 
-		GraphicsPipelineDesc panormaToCubePipeline;
+		if (_vulkan.createComputePipeline(panoramaToCubeMapPipeline, panoramaToCubeMapComputeShader, entryPoint, panoramaPipelineLayout) != VK_SUCCESS)
+		{
+			return Result::VulkanError;
+		}
+	}
 
-		panormaToCubePipeline.addShaderStage(fullscreenVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "main");
-		panormaToCubePipeline.addShaderStage(panoramaToCubeMapFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "panoramaToCubeMap");
+	_vulkan.bindDescriptorSet(_commandBuffer, panoramaPipelineLayout, panoramaSet, VK_PIPELINE_BIND_POINT_COMPUTE);
 
-		panormaToCubePipeline.setRenderPass(renderPass);
-		panormaToCubePipeline.setPipelineLayout(panoramaPipelineLayout);
+	vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, panoramaToCubeMapPipeline);
 
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_FALSE;
+	// 8x8 texels per workgroup, one z slice per face of every cube map
+	const uint32_t groupCount = (cubeMapSideLength + 7u) / 8u;
+	vkCmdDispatch(_commandBuffer, groupCount, groupCount, cubeMapLayers);
 
-		panormaToCubePipeline.addColorBlendAttachment(colorBlendAttachment,6);
+	return res;
+}
 
-		panormaToCubePipeline.setViewportExtent(VkExtent2D{ cubeMapSideLength, cubeMapSideLength });
+// set through setPipelineCacheDirectory
+bool g_pipelineCacheDirectorySet = false;
+std::string g_pipelineCacheDirectory;
 
-		if (_vulkan.createPipeline(panoramaToCubeMapPipeline, panormaToCubePipeline.getInfo()) != VK_SUCCESS)
-		{
-			return Result::VulkanError;
-		}
+// empty if the pipeline cache is not stored
+std::string getPipelineCacheDirectory()
+{
+	if (g_pipelineCacheDirectorySet)
+	{
+		return g_pipelineCacheDirectory;
 	}
 
-	/// Render Pass
-	std::vector<VkImageView> inputCubeMapViews(6u, VK_NULL_HANDLE);
-	for (size_t i = 0; i < inputCubeMapViews.size(); i++)
+	const char* directory = getenv("IBLSAMPLER_PIPELINE_CACHE_DIR");
+	if (directory != nullptr)
 	{
-		if (_vulkan.createImageView(inputCubeMapViews[i], _cubeMapImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, static_cast<uint32_t>(i), 1u }) != VK_SUCCESS)
-		{
-			return Result::VulkanError;
-		}
+		return directory;
 	}
 
-	VkFramebuffer cubeMapInputFramebuffer = VK_NULL_HANDLE;
-	if (_vulkan.createFramebuffer(cubeMapInputFramebuffer, renderPass, cubeMapSideLength, cubeMapSideLength, inputCubeMapViews, 1u) != VK_SUCCESS)
+	// per user cache directory, falls back to the working directory
+#ifdef _WIN32
+	const char* base = getenv("LOCALAPPDATA");
+	const char* suffix = "";
+#else
+	const char* base = getenv("XDG_CACHE_HOME");
+	const char* suffix = "";
+	if (base == nullptr || base[0] == '\0')
 	{
-		return Result::VulkanError;
+		base = getenv("HOME");
+		suffix = "/.cache";
 	}
+#endif
 
+	if (base == nullptr || base[0] == '\0')
 	{
-		VkImageSubresourceRange  subresourceRangeBaseMiplevel = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, maxMipLevels, 0u, 6u };
-
-		_vulkan.imageBarrier(_commandBuffer, _cubeMapImage,
-												 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-												 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,// src stage, access
-												 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, //dst stage, access
-												 subresourceRangeBaseMiplevel);
+		return ".";
 	}
 
-	_vulkan.bindDescriptorSet(_commandBuffer, panoramaPipelineLayout, panoramaSet);
-
-	vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, panoramaToCubeMapPipeline);
-
-	const std::vector<VkClearValue> clearValues(6u, { 0.0f, 0.0f, 1.0f, 1.0f });
-
-	_vulkan.beginRenderPass(_commandBuffer, renderPass, cubeMapInputFramebuffer, VkRect2D{ 0u, 0u, cubeMapSideLength, cubeMapSideLength }, clearValues);
-	vkCmdDraw(_commandBuffer, 3, 1u, 0, 0);
-	_vulkan.endRenderPass(_commandBuffer);
-
-	return res;
+	return std::string(base) + suffix + "/glTF-IBL-Sampler";
 }
 } // !IBLLib
 
+void IBLLib::setPipelineCacheDirectory(const char* _directory)
+{
+	g_pipelineCacheDirectorySet = _directory != nullptr;
+	g_pipelineCacheDirectory = _directory != nullptr ? _directory : "";
+}
 
-IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput)
+IBLLib::Result IBLLib::sampleArray(const std::vector<const char*>& _inputPaths, const std::vector<const char*>& _outputPathsCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput, Statistics* _outStatistics)
 {
+	TraceZone zone("sample");
+
+	const Clock::time_point start = Clock::now();
+	Statistics statistics;
+
 	const VkFormat cubeMapFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
 	const VkFormat LUTFormat = VK_FORMAT_R8G8B8A8_UNORM;
 
+	// every input is one cube map in the layers [6i, 6i + 6) of the cube map images
+	const uint32_t cubeCount = static_cast<uint32_t>(_inputPaths.size());
+
+	if (cubeCount == 0u || (_outputPathsCubeMap.size() != 1u && _outputPathsCubeMap.size() != cubeCount))
+	{
+		printf("Error: expected one output cube map path or one per input\n");
+		return Result::InvalidArgument;
+	}
+
 	IBLLib::Result res = Result::Success;
 
 	vkHelper vulkan;
 
-	if (vulkan.initialize(0u, 1u, _debugOutput) != VK_SUCCESS)
+	// the filter pass uses one descriptor set per cube map
+	const uint32_t descriptorPoolSizeFactor = (cubeCount + 8u) / 8u;
+
+	const std::string pipelineCacheDirectory = getPipelineCacheDirectory();
+	if (vulkan.initialize(0u, descriptorPoolSizeFactor, _debugOutput, pipelineCacheDirectory.empty() ? nullptr : pipelineCacheDirectory.c_str()) != VK_SUCCESS)
 	{
 		return Result::VulkanInitializationFailed;
 	}
 
-	VkImage panoramaImage;
-	if ((res = uploadImage(vulkan, _inputPath, panoramaImage)) != Result::Success)
+	if (6u * cubeCount > vulkan.getLimits().maxImageArrayLayers)
 	{
-		return res;
+		printf("Error: %u inputs exceed the %u array layers of an image\n", cubeCount, vulkan.getLimits().maxImageArrayLayers);
+		return Result::InvalidArgument;
+	}
+
+	statistics.initialize = millisecondsSince(start);
+	const Clock::time_point decodeStart = Clock::now();
+
+	std::vector<std::unique_ptr<InputImage>> inputs;
+	inputs.reserve(cubeCount);
+
+	for (const char* inputPath : _inputPaths)
+	{
+		inputs.emplace_back(new InputImage());
+		if ((res = loadInput(vulkan, inputPath, *inputs.back())) != Result::Success)
+		{
+			return res;
+		}
+
+		// the inputs of a batch share the images
+		const InputImage& first = *inputs.front();
+		const InputImage& input = *inputs.back();
+
+		if ((input.source == InputSource::CubeMap) != (first.source == InputSource::CubeMap) || input.format != first.format ||
+			input.width != first.width || input.height != first.height ||
+			(input.source == InputSource::CubeMap && input.cubeMap.getLevels() != first.cubeMap.getLevels()))
+		{
+			printf("Input %s differs from %s in kind, format, resolution or mip levels\n", inputPath, _inputPaths.front());
+			return Result::InvalidArgument;
+		}
+	}
+
+	statistics.decode = millisecondsSince(decodeStart);
+
+	const InputImage& firstInput = *inputs.front();
+	const InputSource inputSource = firstInput.source;
+
+	// radiance scanlines are decoded into the staging buffers and KTX2 input is read from the file mapping
+	HostMemory hostMemory;
+	for (const std::unique_ptr<InputImage>& input : inputs)
+	{
+		hostMemory.add(input->exrReader.getByteSize());
+		hostMemory.add(input->cubeMap.getHostByteSize());
+		if (input->source == InputSource::STB)
+		{
+			hostMemory.add(input->panorama.getByteSize());
+		}
 	}
 
+	ThreadPool threadPool;
+
 	VkShaderModule fullscreenVertexShader = VK_NULL_HANDLE;
-	if ((res = compileShader(vulkan, primitiveVertexShader, "main", fullscreenVertexShader, ShaderCompiler::Stage::Vertex)) != Result::Success)
+	if ((res = loadShader(vulkan, Shader::FullscreenVertex, fullscreenVertexShader)) != Result::Success)
 	{
 		return res;
 	}
 
 	VkShaderModule filterCubeMapFragmentShader = VK_NULL_HANDLE;
-	if ((res = compileShader(vulkan, filterFragmentShader, "filterCubeMap", filterCubeMapFragmentShader, ShaderCompiler::Stage::Fragment)) != Result::Success)
+	if ((res = loadShader(vulkan, Shader::FilterCubeMap, filterCubeMapFragmentShader)) != Result::Success)
 	{
 		return res;
 	}
 
-	VkExtent3D panoramaExtent = vulkan.getCreateInfo(panoramaImage)->extent;
+	const bool cubeMapInput = inputSource == InputSource::CubeMap;
+
 	// it is best to sample an nxn cube map from a 4nx2n equirectangular image, e.g. a 1024x512 equirectangular images becomes a 256x256 cube map.
-	_cubemapResolution = _cubemapResolution != 0 ? _cubemapResolution : panoramaExtent.height / 2;
+	// cube map inputs keep their resolution
+	const uint32_t defaultResolution = cubeMapInput ? firstInput.width : firstInput.height / 2;
+	_cubemapResolution = _cubemapResolution != 0 ? _cubemapResolution : defaultResolution;
 	_mipmapCount = _mipmapCount != 0 ? _mipmapCount : static_cast<uint32_t>(floor(log2(_cubemapResolution)));
 
 	const uint32_t cubeMapSideLength = _cubemapResolution;
 	const uint32_t outputMipLevels = _distribution == Distribution::Lambertian ? 1u : _mipmapCount;
+	const uint32_t inputSideLength = cubeMapInput ? firstInput.width : cubeMapSideLength;
 
 	uint32_t maxMipLevels = 0u;
-	for (uint32_t m = cubeMapSideLength; m > 0; m = m >> 1, ++maxMipLevels) {}
+	for (uint32_t m = inputSideLength; m > 0; m = m >> 1, ++maxMipLevels) {}
+
+	// mip levels stored in the file are used as they are, otherwise the chain is generated from level 0
+	const bool generateMips = cubeMapInput == false || firstInput.cubeMap.getLevels() == 1u;
+	if (generateMips == false)
+	{
+		maxMipLevels = std::min(maxMipLevels, firstInput.cubeMap.getLevels());
+	}
+
+	// the input cube map is filtered in the format of the file
+	const VkFormat inputFormat = cubeMapInput ? firstInput.format : cubeMapFormat;
+
+	if (cubeMapInput)
+	{
+		VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if (generateMips)
+		{
+			features |= VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		}
+
+		if (getFormatSize(inputFormat) == 0u || vulkan.isFormatSupported(inputFormat, features) == false)
+		{
+			printf("Error: format %u of the input cube map can not be filtered\n", static_cast<uint32_t>(inputFormat));
+			return Result::InvalidArgument;
+		}
+	}
 
 	if ((_cubemapResolution >> (outputMipLevels - 1)) < 1)
 	{
@@ -739,70 +1115,174 @@ IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCub
 			return Result::VulkanError;
 		}
 	}
-	
-	VkImage inputCubeMap = VK_NULL_HANDLE;
-	VkImageLayout currentInputCubeMapLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	////////////////////////////////////////////////////////////////////////////////////////
+	// Declare images and passes, the graph places barriers and lets images with disjoint lifetimes share memory
+	RenderGraph graph(vulkan);
+
+	// the panoramas are layers of one image, the cube maps are packed into the layers of the cube map images.
+	// radiance texels are decoded on the GPU, 8 bit images are decoded by the sampler
+	RenderGraph::ImageHandle panoramaImage = UINT32_MAX;
+	VkImageUsageFlags inputCubeMapUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	if (cubeMapInput == false)
+	{
+		panoramaImage = graph.createImage2D("panorama", firstInput.width, firstInput.height, firstInput.format,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1u, cubeCount);
+		inputCubeMapUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
+
+	const RenderGraph::ImageHandle inputCubeMap = graph.createImage2D("input cube map", inputSideLength, inputSideLength, inputFormat,
+		inputCubeMapUsage, maxMipLevels, 6u * cubeCount, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
 
 	//VK_IMAGE_USAGE_TRANSFER_SRC_BIT needed for transfer to staging buffer
-	if (vulkan.createImage2DAndAllocate(inputCubeMap, cubeMapSideLength, cubeMapSideLength, cubeMapFormat,
-																			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-																			maxMipLevels, 6u, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) != VK_SUCCESS)
+	const RenderGraph::ImageHandle outputCubeMap = graph.createImage2D("output cube map", cubeMapSideLength, cubeMapSideLength, cubeMapFormat,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		outputMipLevels, 6u * cubeCount, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+
+	const RenderGraph::ImageHandle outputLUT = graph.createImage2D("LUT", cubeMapSideLength, cubeMapSideLength, LUTFormat,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT /*| VK_IMAGE_USAGE_SAMPLED_BIT*/);
+
+	const VkFormat targetFormat = static_cast<VkFormat>(_targetFormat);
+	RenderGraph::ImageHandle resultCubeMap = outputCubeMap;
+
+	if (targetFormat != cubeMapFormat)
 	{
-		return Result::VulkanError;
+		resultCubeMap = graph.createImage2D("converted cube map", cubeMapSideLength, cubeMapSideLength, targetFormat,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, outputMipLevels, 6u * cubeCount);
 	}
-	
-	VkImageView inputCubeMapCompleteView = VK_NULL_HANDLE;
-	if (vulkan.createImageView(inputCubeMapCompleteView, inputCubeMap, { VK_IMAGE_ASPECT_COLOR_BIT, 0u, maxMipLevels, 0u, 6u }, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_CUBE) != VK_SUCCESS)
+
+	// uploaded between compile and execute
+	graph.setInitialAccess(cubeMapInput ? inputCubeMap : panoramaImage, RenderGraph::Access::TransferWrite);
+	graph.markOutput(resultCubeMap);
+
+	if (_outputPathLUT != nullptr)
 	{
-		return Result::VulkanError;
+		graph.markOutput(outputLUT);
 	}
-	
-	VkImage outputCubeMap = VK_NULL_HANDLE;
-	if (vulkan.createImage2DAndAllocate(outputCubeMap, cubeMapSideLength, cubeMapSideLength, cubeMapFormat,
-																			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-																			outputMipLevels, 6u, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) != VK_SUCCESS)
+
+	// framebuffers are released once the graph has executed
+	std::vector<UniqueFramebuffer> filterOutputFramebuffers;
+
+	// pass indices map the pass times to the statistics
+	const uint32_t panoramaPass = graph.getPassCount();
+
+	if (cubeMapInput == false)
 	{
-		return Result::VulkanError;
+		graph.addPass("panorama to cube map")
+			.use(panoramaImage, RenderGraph::Access::ComputeSampledRead)
+			.use(inputCubeMap, RenderGraph::Access::StorageWrite)
+			.record([&](VkCommandBuffer _cmdBuffer) -> Result
+			{
+				printf("Transform panorama image to cube map\n");
+				return panoramaToCubemap(vulkan, _cmdBuffer, graph.getImage(panoramaImage), graph.getImage(inputCubeMap));
+			});
 	}
 
-	std::vector< std::vector<VkImageView> > outputCubeMapViews(outputMipLevels);
-	for (uint32_t i = 0; i < outputMipLevels; ++i)
+	const uint32_t mipGenerationPass = graph.getPassCount();
+
+	if (generateMips)
 	{
-		outputCubeMapViews[i].resize(6, VK_NULL_HANDLE); //sides of the cube
+		graph.addPass("generate mipmap levels")
+			.use(inputCubeMap, RenderGraph::Access::TransferReadWrite)
+			.record([&](VkCommandBuffer _cmdBuffer) -> Result
+			{
+				printf("Generating mipmap levels\n");
+				generateMipmapLevels(vulkan, _cmdBuffer, graph.getImage(inputCubeMap), maxMipLevels, inputSideLength, 6u * cubeCount);
+				return Result::Success;
+			});
+	}
 
-		for (uint32_t j = 0; j < 6; j++)
-		{
-			VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u };
-			subresourceRange.baseMipLevel = i;
-			subresourceRange.baseArrayLayer = j;
-			if (vulkan.createImageView(outputCubeMapViews[i][j], outputCubeMap, subresourceRange) != VK_SUCCESS)
+	// recorded below, after the filter pipeline was created
+	std::function<Result(VkCommandBuffer, uint32_t)> recordFilter;
+
+	// one pass per mip level so every level can be timed.
+	// The mip levels are filtered from the smallest mipmap to the largest mipmap,
+	// i.e. the last mipmap is filtered last.
+	// This has the desirable side effect that the framebuffer size of the last filter pass
+	// matches with the LUT size, allowing the LUT to only be written in the last pass
+	// without worrying to preserve the LUT's image contents between the previous render passes.
+	const uint32_t firstFilterPass = graph.getPassCount();
+
+	for (uint32_t currentMipLevel = outputMipLevels - 1; currentMipLevel != -1; currentMipLevel--)
+	{
+		graph.addPass("filter")
+			.use(inputCubeMap, RenderGraph::Access::SampledRead)
+			.use(outputCubeMap, RenderGraph::Access::ColorAttachmentWrite)
+			.use(outputLUT, RenderGraph::Access::ColorAttachmentWrite)
+			.record([&recordFilter, currentMipLevel](VkCommandBuffer _cmdBuffer) -> Result { return recordFilter(_cmdBuffer, currentMipLevel); });
+	}
+
+	const uint32_t formatConversionPass = graph.getPassCount();
+
+	if (resultCubeMap != outputCubeMap)
+	{
+		graph.addPass("convert format")
+			.use(outputCubeMap, RenderGraph::Access::TransferRead)
+			.use(resultCubeMap, RenderGraph::Access::TransferWrite)
+			.record([&](VkCommandBuffer _cmdBuffer) -> Result
 			{
-				return Result::VulkanError;
-			}
-		}
+				return convertVkFormat(vulkan, _cmdBuffer, graph.getImage(outputCubeMap), graph.getImage(resultCubeMap));
+			});
 	}
 
-	VkImageView outputCubeMapCompleteView = VK_NULL_HANDLE;
+	if (graph.compile() != VK_SUCCESS)
 	{
-		VkImageSubresourceRange subresourceRange{};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseArrayLayer = 0u;
-		subresourceRange.baseMipLevel = 0u;
-		subresourceRange.layerCount = 6u;
-		subresourceRange.levelCount = outputMipLevels;
+		return Result::VulkanError;
+	}
+
+	const Clock::time_point uploadStart = Clock::now();
+
+	if (cubeMapInput)
+	{
+		// without stored mips only level 0 is uploaded, the others are generated
+		res = uploadCubeMaps(vulkan, inputs, generateMips ? 1u : maxMipLevels, graph.getImage(inputCubeMap));
+	}
+	else
+	{
+		res = uploadPanoramas(vulkan, inputs, threadPool, graph.getImage(panoramaImage));
+	}
+
+	if (res != Result::Success)
+	{
+		printf("Failed to upload input image\n");
+		return res;
+	}
+
+	statistics.upload = millisecondsSince(uploadStart);
+
+	for (const std::unique_ptr<InputImage>& input : inputs)
+	{
+		input->hdrReader.close();
+		hostMemory.remove(input->exrReader.getByteSize());
+		input->exrReader.release();
+	}
 
-		if (vulkan.createImageView(outputCubeMapCompleteView, outputCubeMap, subresourceRange, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_CUBE) != VK_SUCCESS)
+	// cube views of the single cube maps, sampling a cube map array would need the imageCubeArray feature
+	std::vector<VkImageView> inputCubeMapCompleteViews(cubeCount, VK_NULL_HANDLE);
+	for (uint32_t cube = 0u; cube < cubeCount; ++cube)
+	{
+		if (vulkan.createImageView(inputCubeMapCompleteViews[cube], graph.getImage(inputCubeMap), { VK_IMAGE_ASPECT_COLOR_BIT, 0u, maxMipLevels, 6u * cube, 6u }, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_CUBE) != VK_SUCCESS)
 		{
 			return Result::VulkanError;
 		}
 	}
 
-	VkImage outputLUT = VK_NULL_HANDLE;
-	if (vulkan.createImage2DAndAllocate(outputLUT, cubeMapSideLength, cubeMapSideLength, LUTFormat,
-																			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT /*| VK_IMAGE_USAGE_SAMPLED_BIT*/,
-																			1u, 1u, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE) != VK_SUCCESS)
+	std::vector< std::vector<VkImageView> > outputCubeMapViews(outputMipLevels);
+	for (uint32_t i = 0; i < outputMipLevels; ++i)
 	{
-		return Result::VulkanError;
+		outputCubeMapViews[i].resize(6u * cubeCount, VK_NULL_HANDLE); //sides of all cubes
+
+		for (uint32_t j = 0; j < 6u * cubeCount; j++)
+		{
+			VkImageSubresourceRange subresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u };
+			subresourceRange.baseMipLevel = i;
+			subresourceRange.baseArrayLayer = j;
+			if (vulkan.createImageView(outputCubeMapViews[i][j], graph.getImage(outputCubeMap), subresourceRange) != VK_SUCCESS)
+			{
+				return Result::VulkanError;
+			}
+		}
 	}
 
 	VkImageView outputLUTView = VK_NULL_HANDLE;
@@ -812,13 +1292,16 @@ IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCub
 		subresourceRange.layerCount = 1u;
 		subresourceRange.levelCount = 1u;
 
-		if (vulkan.createImageView(outputLUTView, outputLUT, subresourceRange, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_2D) != VK_SUCCESS)
+		if (vulkan.createImageView(outputLUTView, graph.getImage(outputLUT), subresourceRange, VK_FORMAT_UNDEFINED, VK_IMAGE_VIEW_TYPE_2D) != VK_SUCCESS)
 		{
 			return Result::VulkanError;
 		}
 	}
 
+	// the LUT is only attached to the render pass of the last cube map. the render passes of a filter pass are not
+	// synchronized with each other, the others would store undefined LUT values racing with it
 	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkRenderPass renderPassWithoutLUT = VK_NULL_HANDLE;
 	{
 		RenderPassDesc renderPassDesc;
 
@@ -828,6 +1311,11 @@ IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCub
 			renderPassDesc.addAttachment(cubeMapFormat);
 		}
 
+		if (cubeCount > 1u && vulkan.createRenderPass(renderPassWithoutLUT, renderPassDesc.getInfo()) != VK_SUCCESS)
+		{
+			return Result::VulkanError;
+		}
+
 		renderPassDesc.addAttachment(LUTFormat);		
 
 		if (vulkan.createRenderPass(renderPass, renderPassDesc.getInfo()) != VK_SUCCESS)
@@ -837,66 +1325,82 @@ IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCub
 	}
 
 	//Push Constants for specular and diffuse filter passes
-	struct PushConstant
-	{
-		float roughness = 0.f;
-		uint32_t sampleCount = 1u;
-		uint32_t mipLevel = 1u;
-		uint32_t width = 1024u;
-		float lodBias = 0.f;
-		Distribution distribution = Distribution::Lambertian;
-	};
-
 	std::vector<VkPushConstantRange> ranges(1u);
 	VkPushConstantRange& range = ranges.front();
 
 	range.offset = 0u;
-	range.size = sizeof(PushConstant);
+	range.size = sizeof(FilterParameters);
 	range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	////////////////////////////////////////////////////////////////////////////////////////
 	// Filter CubeMap Pipeline
-	VkDescriptorSet filterDescriptorSet = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> filterDescriptorSets(cubeCount, VK_NULL_HANDLE); // one per cube map
 	VkPipelineLayout filterPipelineLayout = VK_NULL_HANDLE;
 	VkPipeline filterPipeline = VK_NULL_HANDLE;
+	VkPipeline filterPipelineWithoutLUT = VK_NULL_HANDLE; // for renderPassWithoutLUT
 	{
-		DescriptorSetInfo setLayout0;
-		uint32_t binding = 1u;
-		setLayout0.addCombinedImageSampler(cubeMipMapSampler, inputCubeMapCompleteView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, binding, VK_SHADER_STAGE_FRAGMENT_BIT); // change sampler ?
-
+		// the set layouts are identical, the pipeline layout is created with the first
 		VkDescriptorSetLayout filterSetLayout = VK_NULL_HANDLE;
-		if (setLayout0.create(vulkan, filterSetLayout, filterDescriptorSet) != VK_SUCCESS)
+
+		for (uint32_t cube = 0u; cube < cubeCount; ++cube)
 		{
-			return Result::VulkanError;
-		}
+			DescriptorSetInfo setLayout0;
+			uint32_t binding = 1u;
+			setLayout0.addCombinedImageSampler(cubeMipMapSampler, inputCubeMapCompleteViews[cube], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, binding, VK_SHADER_STAGE_FRAGMENT_BIT); // change sampler ?
+
+			VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+			if (setLayout0.create(vulkan, setLayout, filterDescriptorSets[cube]) != VK_SUCCESS)
+			{
+				return Result::VulkanError;
+			}
+
+			vulkan.updateDescriptorSets(setLayout0.getWrites());
 
-		vulkan.updateDescriptorSets(setLayout0.getWrites());
+			if (cube == 0u)
+			{
+				filterSetLayout = setLayout;
+			}
+		}
 
 		if (vulkan.createPipelineLayout(filterPipelineLayout, filterSetLayout, ranges) != VK_SUCCESS)
 		{
 			return Result::VulkanError;
 		}
 
-		GraphicsPipelineDesc filterCubeMapPipelineDesc;
+		// the LUT output of the shader is discarded without the attachment
+		const auto createFilterPipeline = [&](VkPipeline& _outPipeline, VkRenderPass _renderPass, bool _withLUT) -> VkResult
+		{
+			GraphicsPipelineDesc filterCubeMapPipelineDesc;
 
-		filterCubeMapPipelineDesc.addShaderStage(fullscreenVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "main");
-		filterCubeMapPipelineDesc.addShaderStage(filterCubeMapFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "filterCubeMap");
+			filterCubeMapPipelineDesc.addShaderStage(fullscreenVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "main");
+			filterCubeMapPipelineDesc.addShaderStage(filterCubeMapFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "filterCubeMap");
 
-		filterCubeMapPipelineDesc.setRenderPass(renderPass);
-		filterCubeMapPipelineDesc.setPipelineLayout(filterPipelineLayout);
+			filterCubeMapPipelineDesc.setRenderPass(_renderPass);
+			filterCubeMapPipelineDesc.setPipelineLayout(filterPipelineLayout);
 
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT; // TODO: rgb only
-		colorBlendAttachment.blendEnable = VK_FALSE;
+			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT; // TODO: rgb only
+			colorBlendAttachment.blendEnable = VK_FALSE;
 
-		filterCubeMapPipelineDesc.addColorBlendAttachment(colorBlendAttachment, 6u);
+			filterCubeMapPipelineDesc.addColorBlendAttachment(colorBlendAttachment, 6u);
 
-		//colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
-		filterCubeMapPipelineDesc.addColorBlendAttachment(colorBlendAttachment, 1u);
+			if (_withLUT)
+			{
+				//colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+				filterCubeMapPipelineDesc.addColorBlendAttachment(colorBlendAttachment, 1u);
+			}
+
+			filterCubeMapPipelineDesc.setViewportExtent(VkExtent2D{ cubeMapSideLength, cubeMapSideLength });
 
-		filterCubeMapPipelineDesc.setViewportExtent(VkExtent2D{ cubeMapSideLength, cubeMapSideLength });
+			return vulkan.createPipeline(_outPipeline, filterCubeMapPipelineDesc.getInfo());
+		};
+
+		if (createFilterPipeline(filterPipeline, renderPass, true) != VK_SUCCESS)
+		{
+			return Result::VulkanError;
+		}
 
-		if (vulkan.createPipeline(filterPipeline, filterCubeMapPipelineDesc.getInfo()) != VK_SUCCESS)
+		if (cubeCount > 1u && createFilterPipeline(filterPipelineWithoutLUT, renderPassWithoutLUT, false) != VK_SUCCESS)
 		{
 			return Result::VulkanError;
 		}
@@ -904,146 +1408,224 @@ IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCub
 
 	const std::vector<VkClearValue> clearValues(6u, { 0.0f, 0.0f, 1.0f, 1.0f });
 
-	VkCommandBuffer cubeMapCmd;
-	if (vulkan.createCommandBuffer(cubeMapCmd) != VK_SUCCESS)
-	{
-		return Result::VulkanError;
-	}
+	filterOutputFramebuffers.reserve(outputMipLevels * cubeCount);
 
-	if (vulkan.beginCommandBuffer(cubeMapCmd, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != VK_SUCCESS)
+	recordFilter = [&](VkCommandBuffer cubeMapCmd, uint32_t currentMipLevel) -> Result
 	{
-		return Result::VulkanError;
-	}
-
-	////////////////////////////////////////////////////////////////////////////////////////
-	// Transform panorama image to cube map
+		// the smallest level is filtered first
+		if (currentMipLevel == outputMipLevels - 1)
+		{
+			switch (_distribution)
+			{
+				case IBLLib::Distribution::Lambertian:
+					printf("Filtering lambertian\n");
+					break;
+				case IBLLib::Distribution::GGX:
+					printf("Filtering GGX\n");
+					break;
+				case IBLLib::Distribution::Charlie:
+					printf("Filtering Charlie\n");
+					break;
+				default:
+					break;
+			}
+		}
 
-	printf("Transform panorama image to cube map\n");
+		// Filter mip level currentMipLevel from inputCubeMap
+		unsigned int currentFramebufferSideLength = cubeMapSideLength >> currentMipLevel;
 
-	res = panoramaToCubemap(vulkan, cubeMapCmd, fullscreenVertexShader, panoramaImage, inputCubeMap);
-	if (res != VK_SUCCESS)
-	{
-		printf("Failed to transform panorama image to cube map\n");
-		return res;
-	}
+		FilterParameters values{};
+		values.roughness = static_cast<float>(currentMipLevel) / static_cast<float>(outputMipLevels - 1);
+		values.sampleCount = _sampleCount;
+		values.mipLevel = currentMipLevel;
+		values.width = inputSideLength;
+		values.lodBias = _lodBias;
+		values.distribution = _distribution;
 
-	currentInputCubeMapLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		// one render pass per cube map, all of them recorded into this pass. only the last one writes the LUT
+		for (uint32_t cube = 0u; cube < cubeCount; ++cube)
+		{
+			const bool withLUT = cube + 1u == cubeCount;
+			const VkRenderPass cubeRenderPass = withLUT ? renderPass : renderPassWithoutLUT;
 
-	////////////////////////////////////////////////////////////////////////////////////////
-	//Generate MipLevels
-	printf("Generating mipmap levels\n");
-	generateMipmapLevels(vulkan, cubeMapCmd, inputCubeMap, maxMipLevels, cubeMapSideLength, currentInputCubeMapLayout);
-	currentInputCubeMapLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-	// Filter
-
-	switch (_distribution)
-	{
-		case IBLLib::Distribution::Lambertian:
-			printf("Filtering lambertian\n");
-			break;
-		case IBLLib::Distribution::GGX:
-			printf("Filtering GGX\n");
-			break;
-		case IBLLib::Distribution::Charlie:
-			printf("Filtering Charlie\n");
-			break;
-		default:
-			break;
-	}
+			const std::vector<VkImageView>& levelViews = outputCubeMapViews[currentMipLevel];
+			std::vector<VkImageView> renderTargetViews(levelViews.begin() + 6u * cube, levelViews.begin() + 6u * (cube + 1u));
 
-	vulkan.bindDescriptorSet(cubeMapCmd, filterPipelineLayout, filterDescriptorSet);
+			if (withLUT)
+			{
+				renderTargetViews.emplace_back(outputLUTView);
+			}
 
-	vkCmdBindPipeline(cubeMapCmd, VK_PIPELINE_BIND_POINT_GRAPHICS, filterPipeline);
+			filterOutputFramebuffers.emplace_back(vulkan);
+			UniqueFramebuffer& filterOutputFramebuffer = filterOutputFramebuffers.back();
+			if (vulkan.createFramebuffer(filterOutputFramebuffer.out(), cubeRenderPass, currentFramebufferSideLength, currentFramebufferSideLength, renderTargetViews, 1u) != VK_SUCCESS)
+			{
+				return Result::VulkanError;
+			}
 
-	// Filter every mip level: from inputCubeMap->currentMipLevel
-	// The mip levels are filtered from the smallest mipmap to the largest mipmap,
-	// i.e. the last mipmap is filtered last.
-	// This has the desirable side effect that the framebuffer size of the last filter pass
-	// matches with the LUT size, allowing the LUT to only be written in the last pass
-	// without worrying to preserve the LUT's image contents between the previous render passes.
-	for (uint32_t currentMipLevel = outputMipLevels - 1; currentMipLevel != -1; currentMipLevel--)
-	{
-		unsigned int currentFramebufferSideLength = cubeMapSideLength >> currentMipLevel;
-		std::vector<VkImageView> renderTargetViews(outputCubeMapViews[currentMipLevel]);
+			// the shader skips the LUT where it is not attached
+			values.writeLUT = withLUT ? 1u : 0u;
 
-		renderTargetViews.emplace_back(outputLUTView);
+			vkCmdBindPipeline(cubeMapCmd, VK_PIPELINE_BIND_POINT_GRAPHICS, withLUT ? filterPipeline : filterPipelineWithoutLUT);
+			vulkan.bindDescriptorSet(cubeMapCmd, filterPipelineLayout, filterDescriptorSets[cube]);
+			vkCmdPushConstants(cubeMapCmd, filterPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FilterParameters), &values);
 
-		//Framebuffer will be destroyed automatically at shutdown
-		VkFramebuffer filterOutputFramebuffer = VK_NULL_HANDLE;
-		if (vulkan.createFramebuffer(filterOutputFramebuffer, renderPass, currentFramebufferSideLength, currentFramebufferSideLength, renderTargetViews, 1u) != VK_SUCCESS)
-		{
-			return Result::VulkanError;
+			vulkan.beginRenderPass(cubeMapCmd, cubeRenderPass, filterOutputFramebuffer, VkRect2D{ 0u, 0u, currentFramebufferSideLength, currentFramebufferSideLength }, clearValues);
+			vkCmdDraw(cubeMapCmd, 3, 1u, 0, 0);
+			vulkan.endRenderPass(cubeMapCmd);
 		}
 
-		VkImageSubresourceRange  subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, currentMipLevel, 1u, 0u, 6u };
-
-		vulkan.imageBarrier(cubeMapCmd, outputCubeMap,
-												VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-												VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,//src stage, access
-												VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // dst stage, access
-												subresourceRange);
-
-		PushConstant values{};
-		values.roughness = static_cast<float>(currentMipLevel) / static_cast<float>(outputMipLevels - 1);
-		values.sampleCount = _sampleCount;
-		values.mipLevel = currentMipLevel;
-		values.width = cubeMapSideLength;
-		values.lodBias = _lodBias;
-		values.distribution = _distribution;
+		return Result::Success;
+	};
 
-		vkCmdPushConstants(cubeMapCmd, filterPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstant), &values);
+	// per pass times are only measured if they are returned
+	const Clock::time_point executeStart = Clock::now();
 
-		vulkan.beginRenderPass(cubeMapCmd, renderPass, filterOutputFramebuffer, VkRect2D{ 0u, 0u, currentFramebufferSideLength, currentFramebufferSideLength }, clearValues);
-		vkCmdDraw(cubeMapCmd, 3, 1u, 0, 0);
-		vulkan.endRenderPass(cubeMapCmd);
+	if ((res = graph.submit(_outStatistics != nullptr)) != Result::Success)
+	{
+		return res;
 	}
 
+	statistics.execute = millisecondsSince(executeStart);
+
 	////////////////////////////////////////////////////////////////////////////////////////
 	//Output
 
-	VkFormat targetFormat = static_cast<VkFormat>(_targetFormat);
-	VkImageLayout currentCubeMapImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	VkImage convertedCubeMap = VK_NULL_HANDLE;
+	// the copies of the outputs are queued behind the passes and finished after them.
+	// with a single output path the cube maps are written as one cube map array
+	const uint32_t outputFileCount = static_cast<uint32_t>(_outputPathsCubeMap.size());
+	const uint32_t cubesPerFile = cubeCount / outputFileCount;
+
+	std::vector<std::unique_ptr<Readback>> cubeMapReadbacks;
+	std::vector<std::unique_ptr<KtxImage>> outputKtx(outputFileCount);
+	Readback lutReadback(vulkan);
 
-	if(targetFormat != cubeMapFormat)
+	for (uint32_t file = 0u; file < outputFileCount; ++file)
 	{
-		if ((res = convertVkFormat(vulkan, cubeMapCmd, outputCubeMap, convertedCubeMap, targetFormat, currentCubeMapImageLayout)) != Success)
+		cubeMapReadbacks.emplace_back(new Readback(vulkan));
+
+		if (submitCubeMapDownload(vulkan, graph.getImage(resultCubeMap), graph.getLayout(resultCubeMap), file * cubesPerFile, cubesPerFile,
+			outputKtx[file], *cubeMapReadbacks[file], statistics, hostMemory) != Result::Success)
 		{
-			printf("Failed to convert Image \n");
-			return res;
+			printf("Failed to download Image \n");
+			return Result::VulkanError;
 		}
-		currentCubeMapImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	}
-	else
+
+	if (_outputPathLUT != nullptr && submit2DImageDownload(vulkan, graph.getImage(outputLUT), graph.getLayout(outputLUT), lutReadback, statistics) != Result::Success)
 	{
-		convertedCubeMap = outputCubeMap;
+		printf("Failed to download Image \n");
+		return Result::VulkanError;
 	}
 
-	if (vulkan.endCommandBuffer(cubeMapCmd) != VK_SUCCESS)
+	const Clock::time_point waitStart = Clock::now();
+
+	std::vector<double> passMilliseconds;
+	if ((res = graph.wait(_outStatistics != nullptr ? &passMilliseconds : nullptr)) != Result::Success)
 	{
-		return Result::VulkanError;
+		return res;
 	}
 
-	if (vulkan.executeCommandBuffer(cubeMapCmd) != VK_SUCCESS)
+	statistics.execute += millisecondsSince(waitStart);
+
+	// the passes completed, the staging buffers of the readbacks are allocated
+	if (_outStatistics != nullptr)
 	{
-		return Result::VulkanError;
+		statistics.memoryBudget = vulkan.hasMemoryBudget();
+
+		for (const vkHelper::MemoryHeapBudget& heap : vulkan.getMemoryBudget())
+		{
+			if (heap.deviceLocal)
+			{
+				statistics.deviceLocalBudget += heap.budget;
+				statistics.deviceLocalUsage += heap.usage;
+			}
+		}
 	}
 
-	if (downloadCubemap(vulkan, convertedCubeMap, _outputPathCubeMap, currentCubeMapImageLayout) != VK_SUCCESS)
+	if (_outStatistics != nullptr)
 	{
-		printf("Failed to download Image \n");
-		return Result::VulkanError;
+		statistics.gpuTimestamps = vulkan.supportsTimestamps();
+
+		if (cubeMapInput == false)
+		{
+			statistics.panoramaToCubeMap = passMilliseconds[panoramaPass];
+		}
+
+		if (generateMips)
+		{
+			statistics.mipGeneration = passMilliseconds[mipGenerationPass];
+		}
+
+		// the filter passes run from the smallest level to level 0
+		statistics.filterMips.resize(outputMipLevels);
+		for (uint32_t level = 0u; level < outputMipLevels; ++level)
+		{
+			statistics.filterMips[level] = passMilliseconds[firstFilterPass + outputMipLevels - 1u - level];
+			statistics.filter += statistics.filterMips[level];
+		}
+
+		if (resultCubeMap != outputCubeMap)
+		{
+			statistics.formatConversion = passMilliseconds[formatConversionPass];
+		}
+	}
+
+	// the graph has released every image except the outputs
+	filterOutputFramebuffers.clear();
+
+	for (uint32_t file = 0u; file < outputFileCount; ++file)
+	{
+		if ((res = finishCubeMapDownload(vulkan, *outputKtx[file], *cubeMapReadbacks[file], _outputPathsCubeMap[file], statistics, hostMemory)) != Result::Success)
+		{
+			printf("Failed to download Image \n");
+			return res;
+		}
 	}
 
 	if (_outputPathLUT != nullptr)
 	{
-		if (download2DImage(vulkan, outputLUT, _outputPathLUT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) != VK_SUCCESS)
+		if ((res = finish2DImageDownload(vulkan, graph.getImage(outputLUT), lutReadback, _outputPathLUT, statistics, hostMemory)) != Result::Success)
 		{
 			printf("Failed to download Image \n");
-			return Result::VulkanError;
+			return res;
+		}
+	}
+
+	statistics.total = millisecondsSince(start);
+
+	if (_outStatistics != nullptr)
+	{
+		const vkHelper::MemoryStatistics memoryStatistics = vulkan.getMemoryStatistics();
+
+		statistics.peakDeviceBytes = memoryStatistics.peakBlockBytes;
+		statistics.peakHostBytes = hostMemory.peakBytes;
+
+		for (uint32_t i = 0u; i < static_cast<uint32_t>(memoryStatistics.memoryTypes.size()); ++i)
+		{
+			const vkHelper::MemoryTypeStatistics& type = memoryStatistics.memoryTypes[i];
+			if (type.peakBlockBytes == 0u)
+			{
+				continue;
+			}
+
+			MemoryTypeUsage usage;
+			usage.memoryTypeIndex = i;
+			usage.heapIndex = type.heapIndex;
+			usage.deviceLocal = (type.flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0u;
+			usage.hostVisible = (type.flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0u;
+			usage.peakAllocatedBytes = type.peakBlockBytes;
+			usage.peakUsedBytes = type.peakUsedBytes;
+			statistics.memoryTypes.push_back(usage);
 		}
+
+		*_outStatistics = statistics;
 	}
 
 	return Result::Success;
 }
+
+IBLLib::Result IBLLib::sample(const char* _inputPath, const char* _outputPathCubeMap, const char* _outputPathLUT, Distribution _distribution, unsigned int _cubemapResolution, unsigned int _mipmapCount, unsigned int _sampleCount, OutputFormat _targetFormat, float _lodBias, bool _debugOutput, Statistics* _outStatistics)
+{
+	return sampleArray({ _inputPath }, { _outputPathCubeMap }, _outputPathLUT, _distribution, _cubemapResolution, _mipmapCount, _sampleCount, _targetFormat, _lodBias, _debugOutput, _outStatistics);
+}
@@ -5,7 +5,6 @@ R""(
 #define UX3D_MATH_PI 3.1415926535897932384626433832795
 #define UX3D_MATH_INV_PI (1.0 / UX3D_MATH_PI)
 
-layout(set = 0, binding = 0) uniform sampler2D uPanorama;
 layout(set = 0, binding = 1) uniform samplerCube uCubeMap;
 
 // enum
@@ -20,6 +19,7 @@ layout(push_constant) uniform FilterParameters {
   uint width;
   float lodBias;
   uint distribution; // enum
+  uint writeLUT; // set where the LUT is attached (last cube map of a batch), the LUT does not depend on the input
 } pFilterParameters;
 
 layout (location = 0) in vec2 inUV;
@@ -73,13 +73,6 @@ vec3 uvToXYZ(int face, vec2 uv)
         return vec3(    -uv.x,  +uv.y,     -1.f);}
 }
 
-vec2 dirToUV(vec3 dir)
-{
-    return vec2(
-            0.5f + 0.5f * atan(dir.z, dir.x) / UX3D_MATH_PI,
-            1.f - acos(dir.y) / UX3D_MATH_PI);
-}
-
 float saturate(float v)
 {
     return clamp(v, 0.0f, 1.0f);
@@ -446,21 +439,6 @@ vec3 LUT(float NdotV, float roughness)
 }
 
 
-// entry point
-void panoramaToCubeMap() 
-{
-	for(int face = 0; face < 6; ++face)
-	{		
-		vec3 scan = uvToXYZ(face, inUV*2.0-1.0);		
-			
-		vec3 direction = normalize(scan);		
-	
-		vec2 src = dirToUV(direction);		
-			
-		writeFace(face, texture(uPanorama, src).rgb);
-	}
-}
-
 // entry point
 void filterCubeMap() 
 {
@@ -485,7 +463,7 @@ void filterCubeMap()
 	// Write LUT:
 	// x-coordinate: NdotV
 	// y-coordinate: roughness
-	if (pFilterParameters.currentMipLevel == 0)
+	if (pFilterParameters.currentMipLevel == 0 && pFilterParameters.writeLUT != 0u)
 	{
 		
 		outLUT = LUT(inUV.x, inUV.y);
@@ -1,9 +1,28 @@
 #include "vkHelper.h"
 #include "FileHelper.h"
+#include "Trace.h"
+#include "format.h"
 #include <cstring>
+#include <algorithm>
+#include <chrono>
 #include "stdio.h"
 
-constexpr auto g_PipelineCachePath = "pipeline.cache";
+// default sizes of sub-allocated memory blocks, clamped to a fraction of the heap size on small heaps
+constexpr VkDeviceSize g_DeviceLocalBlockSize = 256ull * 1024ull * 1024ull;
+constexpr VkDeviceSize g_HostVisibleBlockSize = 64ull * 1024ull * 1024ull;
+
+// a missing pipeline cache is not an error, MappedFile::open would report it
+static bool mapExistingFile(IBLLib::MappedFile& _file, const std::string& _path)
+{
+	FILE* file = fopen(_path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	fclose(file);
+
+	return _file.open(_path.c_str(), false);
+}
 
 IBLLib::vkHelper::vkHelper()
 {
@@ -14,8 +33,10 @@ IBLLib::vkHelper::~vkHelper()
 	shutdown();
 }
 
-VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descriptorPoolSizeFactor, bool _debugOutput)
+VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descriptorPoolSizeFactor, bool _debugOutput, const char* _pipelineCacheDirectory)
 {
+	TraceZone zone("vkHelper::initialize");
+
 	VkResult res = VK_RESULT_MAX_ENUM;
 	m_debugOutputEnabled = _debugOutput;
 	//
@@ -66,16 +87,35 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 			}
 		}
 
+		// optional extensions
+		std::vector<const char*> extensions;
+		{
+			uint32_t extensionCount = 0u;
+			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> available(extensionCount);
+			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, available.data());
+
+			for (const VkExtensionProperties& extension : available)
+			{
+				if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+				{
+					// needed to query VK_EXT_memory_budget on a Vulkan 1.0 instance
+					extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				}
+			}
+		}
+
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		createInfo.pApplicationInfo = &appInfo;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		if (_debugOutput)
 		{
 			createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
 			createInfo.ppEnabledLayerNames = layers.data();
 		}
-		// TODO: extensions and layers if needed
 
 		if ((res = vkCreateInstance(&createInfo, nullptr, &m_instance)) != VK_SUCCESS)
 		{
@@ -84,6 +124,12 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 		}
 
 		printf("Vulkan instance created\n");
+
+		if (extensions.empty() == false)
+		{
+			m_getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+				vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		}
 	}
 
 	//
@@ -113,15 +159,21 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 
 		m_physicalDevice = devices[_phyDeviceIndex];
 
-		VkPhysicalDeviceProperties deviceProperties;
-		vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+		vkGetPhysicalDeviceProperties(m_physicalDevice, &m_deviceProperties);
 
-		printf("Physical Device created: %s\n", deviceProperties.deviceName);
-		printf("APIVersion: %u.%u.%u\n", VK_VERSION_MAJOR(deviceProperties.apiVersion), VK_VERSION_MINOR(deviceProperties.apiVersion), VK_VERSION_PATCH(deviceProperties.apiVersion));
-		printf("DriverVersion: %u\n", deviceProperties.driverVersion);
+		printf("Physical Device created: %s\n", m_deviceProperties.deviceName);
+		printf("APIVersion: %u.%u.%u\n", VK_VERSION_MAJOR(m_deviceProperties.apiVersion), VK_VERSION_MINOR(m_deviceProperties.apiVersion), VK_VERSION_PATCH(m_deviceProperties.apiVersion));
+		printf("DriverVersion: %u\n", m_deviceProperties.driverVersion);
 
 		vkGetPhysicalDeviceFeatures(m_physicalDevice, &m_deviceFeatures); // TODO: check needed features
 		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);		
+
+		m_memoryStatistics.memoryTypes.resize(m_memoryProperties.memoryTypeCount);
+		for (uint32_t i = 0u; i < m_memoryProperties.memoryTypeCount; ++i)
+		{
+			m_memoryStatistics.memoryTypes[i].flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+			m_memoryStatistics.memoryTypes[i].heapIndex = m_memoryProperties.memoryTypes[i].heapIndex;
+		}
 	}
 
 	//
@@ -147,6 +199,7 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 				)
 			{
 				m_queueFamilyIndex = i;
+				m_timestampValidBits = m_deviceProperties.limits.timestampPeriod > 0.f ? family.timestampValidBits : 0u;
 			}
 		}
 
@@ -156,26 +209,81 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 			return VK_RESULT_MAX_ENUM;
 		}
 
+		// uploads go to a family without graphics if there is one, transfer only (DMA engines) before async compute.
+		// the copies start at arbitrary rows, so the family has to copy at texel granularity
+		m_transferQueueFamilyIndex = m_queueFamilyIndex;
+		uint32_t transferFamilyScore = 0u;
+
+		for (uint32_t i = 0; i < queueFamilyCount; ++i)
+		{
+			const VkQueueFamilyProperties& family = queueFamilies[i];
+			const VkExtent3D& granularity = family.minImageTransferGranularity;
+
+			if (family.queueCount == 0u
+				|| (family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				|| (family.queueFlags & VK_QUEUE_TRANSFER_BIT) == 0u
+				|| granularity.width != 1u || granularity.height != 1u || granularity.depth != 1u)
+			{
+				continue;
+			}
+
+			const uint32_t score = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) ? 1u : 2u;
+			if (score > transferFamilyScore)
+			{
+				m_transferQueueFamilyIndex = i;
+				transferFamilyScore = score;
+			}
+		}
+
 		if (m_debugOutputEnabled)
 		{
-			printf("Selected queue index %u\n", m_queueFamilyIndex);
+			printf("Selected queue index %u, transfer queue index %u\n", m_queueFamilyIndex, m_transferQueueFamilyIndex);
 		}
 
 		float queuePriority = 1.0f;
-		VkDeviceQueueCreateInfo queueCreateInfo{};
-		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = m_queueFamilyIndex;
-		queueCreateInfo.queueCount = 1u;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
+		for (uint32_t i = 0u; i < 2u; ++i)
+		{
+			queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfos[i].queueFamilyIndex = i == 0u ? m_queueFamilyIndex : m_transferQueueFamilyIndex;
+			queueCreateInfos[i].queueCount = 1u;
+			queueCreateInfos[i].pQueuePriorities = &queuePriority;
+		}
 
 		VkPhysicalDeviceFeatures deviceFeatures{}; // TODO: fill required device features
 
+		// optional extensions
+		std::vector<const char*> extensions;
+		{
+			uint32_t extensionCount = 0u;
+			vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> available(extensionCount);
+			vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, available.data());
+
+			for (const VkExtensionProperties& extension : available)
+			{
+				if (strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0)
+				{
+					// reports pipeline cache hits
+					extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+					m_pipelineCreationFeedback = true;
+				}
+				else if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0 && m_getMemoryProperties2 != nullptr)
+				{
+					// heap budgets of the driver, they account for other processes
+					extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					m_memoryBudget = true;
+				}
+			}
+		}
+
 		VkDeviceCreateInfo deviceCreateInfo{};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-		deviceCreateInfo.queueCreateInfoCount = 1u;
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+		deviceCreateInfo.queueCreateInfoCount = m_transferQueueFamilyIndex != m_queueFamilyIndex ? 2u : 1u;
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-		deviceCreateInfo.enabledExtensionCount = 0u;
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
 		if ((res = vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_logicalDevice)) != VK_SUCCESS)
 		{
@@ -188,6 +296,7 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 			printf("Logical device created\n");
 		}
 		vkGetDeviceQueue(m_logicalDevice, m_queueFamilyIndex, 0, &m_queue);
+		vkGetDeviceQueue(m_logicalDevice, m_transferQueueFamilyIndex, 0, &m_transferQueue);
 	}
 
 	//
@@ -206,6 +315,18 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 			printf("Failed to create command pool [%u]\n", res);
 			return res;
 		}
+
+		m_transferCommandPool = m_commandPool;
+		if (hasTransferQueue())
+		{
+			cmdPoolCreateInfo.queueFamilyIndex = m_transferQueueFamilyIndex;
+
+			if ((res = vkCreateCommandPool(m_logicalDevice, &cmdPoolCreateInfo, nullptr, &m_transferCommandPool)) != VK_SUCCESS)
+			{
+				printf("Failed to create transfer command pool [%u]\n", res);
+				return res;
+			}
+		}
 		if (m_debugOutputEnabled)
 		{
 			printf("Command pool created\n");
@@ -261,13 +382,44 @@ VkResult IBLLib::vkHelper::initialize(uint32_t _phyDeviceIndex, uint32_t _descri
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 
-		std::vector<char> cache;
-		if (readFile(g_PipelineCachePath, cache))
+		m_pipelineCachePath.clear();
+		m_pipelineCacheStatistics = {};
+
+		// the shared lock outlives the mapping, storePipelineCache of another process waits until the data is copied
+		// into the pipeline cache
+		FileLock cacheLock;
+		MappedFile cache;
+		if (_pipelineCacheDirectory != nullptr && createDirectories(_pipelineCacheDirectory))
+		{
+			// one file per device and driver, gpus of a machine do not evict each other's pipelines
+			char name[96] = {};
+			int length = snprintf(name, sizeof(name), "/pipeline_%08x_%08x_%08x_", m_deviceProperties.vendorID, m_deviceProperties.deviceID, m_deviceProperties.driverVersion);
+			for (uint32_t i = 0u; i < VK_UUID_SIZE; ++i)
+			{
+				length += snprintf(name + length, sizeof(name) - length, "%02x", m_deviceProperties.pipelineCacheUUID[i]);
+			}
+			m_pipelineCachePath = std::string(_pipelineCacheDirectory) + name + ".cache";
+
+			// without the lock file (read only directory) the cache is still loaded
+			cacheLock.lock((m_pipelineCachePath + ".lock").c_str(), true);
+			mapExistingFile(cache, m_pipelineCachePath);
+		}
+
+		if (cache.isOpen())
 		{
-			printf("Vulkan pipeline cache loaded\n");
-			
-			pipelineCacheCreateInfo.initialDataSize = static_cast<uint32_t>(cache.size());
-			pipelineCacheCreateInfo.pInitialData = cache.data();
+			if (isPipelineCacheCompatible(cache.getData(), cache.getSize()))
+			{
+				printf("Vulkan pipeline cache loaded from %s\n", m_pipelineCachePath.c_str());
+
+				pipelineCacheCreateInfo.initialDataSize = cache.getSize();
+				pipelineCacheCreateInfo.pInitialData = cache.getData();
+				m_pipelineCacheStatistics.loadedBytes = cache.getSize();
+			}
+			else
+			{
+				printf("Ignoring incompatible pipeline cache %s\n", m_pipelineCachePath.c_str());
+				m_pipelineCacheStatistics.rejected = true;
+			}
 		}
 
 		if ((res = vkCreatePipelineCache(m_logicalDevice, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache)) != VK_SUCCESS)
@@ -284,6 +436,32 @@ void IBLLib::vkHelper::shutdown()
 {
 	if (m_logicalDevice != VK_NULL_HANDLE)
 	{
+		// submissions and uploads nobody waited for
+		while (m_submissions.empty() == false)
+		{
+			if (waitForSubmission(m_submissions.front().fence) != VK_SUCCESS)
+			{
+				break;
+			}
+		}
+		vkDeviceWaitIdle(m_logicalDevice);
+		m_submissions.clear();
+		retireTransfers(m_pendingTransfers);
+
+		for (const VkSemaphore& semaphore : m_transferSemaphores)
+		{
+			vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
+		}
+		m_transferSemaphores.clear();
+		m_acquireCmdBuffers.clear(); // freed with the command pool
+
+		for (const VkFence& fence : m_fences)
+		{
+			vkDestroyFence(m_logicalDevice, fence, nullptr);
+		}
+		m_fences.clear();
+		m_freeFences.clear();
+
 		// clear framebuffer
 		for (const VkFramebuffer& framebuf : m_frameBuffers)
 		{
@@ -297,20 +475,43 @@ void IBLLib::vkHelper::shutdown()
 		}
 		m_samplers.clear();
 
+		for (const VkQueryPool& pool : m_queryPools)
+		{
+			vkDestroyQueryPool(m_logicalDevice, pool, nullptr);
+		}
+		m_queryPools.clear();
+
 		// clear images
-		for (Image& img : m_images)
+		for (auto& img : m_images)
 		{
-			img.destroy(m_logicalDevice);
+			img.second.destroy(m_logicalDevice);
 		}
 		m_images.clear();
+		m_imageViews.clear();
+		m_aliasGroups.clear();
 
 		// clear buffers
-		for (Buffer& buf : m_buffers)
+		for (auto& buf : m_buffers)
 		{
-			buf.destroy(m_logicalDevice);
+			buf.second.destroy(m_logicalDevice);
 		}
 		m_buffers.clear();
 
+		// release device memory blocks, all images and buffers are gone at this point
+		if (m_debugOutputEnabled)
+		{
+			const MemoryStatistics stats = getMemoryStatistics();
+			printf("Device memory: peak %.1f MiB used, peak %.1f MiB in blocks, %u vkAllocateMemory calls\n",
+				stats.peakUsedBytes / (1024.0 * 1024.0), stats.peakBlockBytes / (1024.0 * 1024.0), stats.deviceAllocationCount);
+		}
+
+		for (MemoryBlock& block : m_memoryBlocks)
+		{
+			destroyMemoryBlock(block);
+		}
+		m_memoryBlocks.clear();
+		m_memoryStatistics = {};
+
 		// clear pipelines
 		for (const VkPipeline& pipeline : m_pipelines)
 		{
@@ -344,20 +545,17 @@ void IBLLib::vkHelper::shutdown()
 
 		if (m_pipelineCache != VK_NULL_HANDLE)
 		{
-			// store the pipeline cache
-			size_t bytes = 0u;
-			if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &bytes, nullptr) == VK_SUCCESS)
+			// nothing to add if every pipeline came from the cache
+			const PipelineCacheStatistics& stats = m_pipelineCacheStatistics;
+			if (m_pipelineCachePath.empty() == false && (stats.misses != 0u || stats.unreported != 0u))
 			{
-				std::vector<char> cache;
-				cache.resize(bytes);
+				storePipelineCache();
+			}
 
-				if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &bytes, cache.data()) == VK_SUCCESS)
-				{
-					if (writeFile(g_PipelineCachePath, cache))
-					{
-						printf("Stored %s [%zukb]\n", g_PipelineCachePath, cache.size() / 1000u);
-					}
-				}				
+			if (m_debugOutputEnabled)
+			{
+				printf("Pipeline cache: %u hits, %u misses, %u unreported, %.1f ms pipeline creation\n",
+					stats.hits, stats.misses, stats.unreported, stats.creationMilliseconds);
 			}
 
 			vkDestroyPipelineCache(m_logicalDevice, m_pipelineCache, nullptr);
@@ -380,6 +578,13 @@ void IBLLib::vkHelper::shutdown()
 		}
 		m_shaderModules.clear();
 
+		if (m_transferCommandPool != m_commandPool)
+		{
+			vkDestroyCommandPool(m_logicalDevice, m_transferCommandPool, nullptr);
+		}
+		m_transferCommandPool = VK_NULL_HANDLE;
+		m_transferQueue = VK_NULL_HANDLE;
+
 		if (m_commandPool != VK_NULL_HANDLE)
 		{
 			vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
@@ -531,76 +736,162 @@ VkResult IBLLib::vkHelper::endCommandBuffers(const std::vector<VkCommandBuffer>&
 	return res;
 }
 
-VkResult IBLLib::vkHelper::executeCommandBuffer(VkCommandBuffer _cmdBuffer) const
+VkResult IBLLib::vkHelper::executeCommandBuffer(VkCommandBuffer _cmdBuffer)
 {
 	return executeCommandBuffers({ _cmdBuffer });
 }
 
-VkResult IBLLib::vkHelper::executeCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers) const
+VkResult IBLLib::vkHelper::executeCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers)
+{
+	VkFence fence = VK_NULL_HANDLE;
+
+	VkResult res = submitCommandBuffers(_cmdBuffers, fence);
+	if (res != VK_SUCCESS)
+	{
+		return res;
+	}
+
+	return waitForSubmission(fence);
+}
+
+VkResult IBLLib::vkHelper::submitCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers, VkFence& _outFence)
 {
 	if (m_queue == VK_NULL_HANDLE || m_logicalDevice == VK_NULL_HANDLE)
 	{
 		return VK_RESULT_MAX_ENUM;
 	}
 
-	VkResult res = VK_SUCCESS;
-	VkFence fence = VK_NULL_HANDLE;
+	Submission submission;
 
-	// create fence
+	VkResult res = acquireFence(submission.fence);
+	if (res != VK_SUCCESS)
 	{
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.pNext = nullptr;
-		fenceInfo.flags = 0u;
-
-		if ((res = vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &fence)) != VK_SUCCESS)
-		{
-			printf("Failed to end create fence [%u]\n", res);
-			return res;
-		}
+		return res;
 	}
 
-	// submit
-	{
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pNext = nullptr;
-		submitInfo.commandBufferCount = static_cast<uint32_t>(_cmdBuffers.size());
-		submitInfo.pCommandBuffers = _cmdBuffers.data();
+	// images uploaded on the transfer queue are acquired in front of the first command buffer
+	std::vector<VkCommandBuffer> cmdBuffers = m_acquireCmdBuffers;
+	cmdBuffers.insert(cmdBuffers.end(), _cmdBuffers.begin(), _cmdBuffers.end());
+	const std::vector<VkPipelineStageFlags> waitStages(m_transferSemaphores.size(), VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-		if ((res = vkQueueSubmit(m_queue, 1u, &submitInfo, fence)) != VK_SUCCESS)
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(m_transferSemaphores.size());
+	submitInfo.pWaitSemaphores = m_transferSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.commandBufferCount = static_cast<uint32_t>(cmdBuffers.size());
+	submitInfo.pCommandBuffers = cmdBuffers.data();
+
+	if ((res = vkQueueSubmit(m_queue, 1u, &submitInfo, submission.fence)) != VK_SUCCESS)
+	{
+		if (res == VK_ERROR_DEVICE_LOST)
 		{
-			if (res == VK_ERROR_DEVICE_LOST)
-			{
-				printf("Failed to submit queue [VK_ERROR_DEVICE_LOST]. Prefiltering likely exceeded the TDRDelay. Consider reducing the quality of sample, outputResolution, or mipLevels.\n");
-			}
-			else
-			{
-				printf("Failed to submit queue [%d].\n", res);
-			}
-			vkDestroyFence(m_logicalDevice, fence, nullptr);
-			return res;
+			printf("Failed to submit queue [VK_ERROR_DEVICE_LOST]. Prefiltering likely exceeded the TDRDelay. Consider reducing the quality of sample, outputResolution, or mipLevels.\n");
 		}
-		if (m_debugOutputEnabled)
+		else
 		{
-			printf("Executing %u command buffers\n", submitInfo.commandBufferCount);
+			printf("Failed to submit queue [%d].\n", res);
 		}
+		m_freeFences.push_back(submission.fence);
+		return res;
+	}
+
+	if (m_debugOutputEnabled)
+	{
+		printf("Executing %u command buffers\n", submitInfo.commandBufferCount);
+	}
+
+	// released once the submission completed, it waited for the uploads
+	submission.semaphores.swap(m_transferSemaphores);
+	submission.acquireCmdBuffers.swap(m_acquireCmdBuffers);
+	submission.transfers.swap(m_pendingTransfers);
+	m_submissions.push_back(std::move(submission));
+
+	_outFence = m_submissions.back().fence;
+
+	return VK_SUCCESS;
+}
+
+VkResult IBLLib::vkHelper::waitForSubmission(VkFence _fence)
+{
+	auto it = std::find_if(m_submissions.begin(), m_submissions.end(), [_fence](const Submission& _submission) { return _submission.fence == _fence; });
+	if (it == m_submissions.end())
+	{
+		return VK_RESULT_MAX_ENUM;
 	}
 
-	// wait / block for execution to be complete
-	if ((res = vkWaitForFences(m_logicalDevice, 1u, &fence, VK_TRUE, UINT64_MAX)) != VK_SUCCESS)
+	VkResult res = VK_SUCCESS;
+	if ((res = vkWaitForFences(m_logicalDevice, 1u, &_fence, VK_TRUE, UINT64_MAX)) != VK_SUCCESS)
 	{
 		printf("Failed to wait for fence [%u]\n", res);
+		return res;
+	}
+
+	Submission submission = std::move(*it);
+	m_submissions.erase(it);
+
+	for (const VkSemaphore& semaphore : submission.semaphores)
+	{
+		vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
 	}
 
-	if ((res = vkQueueWaitIdle(m_queue)) != VK_SUCCESS)
+	for (const VkCommandBuffer& cmdBuffer : submission.acquireCmdBuffers)
 	{
-		printf("Failed to wait for queue [%u]\n", res);
+		destroyCommandBuffer(cmdBuffer);
 	}
 
-	vkDestroyFence(m_logicalDevice, fence, nullptr);
+	retireTransfers(submission.transfers);
 
-	return res;
+	return releaseFence(submission.fence);
+}
+
+bool IBLLib::vkHelper::isSubmissionComplete(VkFence _fence) const
+{
+	auto it = std::find_if(m_submissions.begin(), m_submissions.end(), [_fence](const Submission& _submission) { return _submission.fence == _fence; });
+	if (it == m_submissions.end())
+	{
+		// already waited for, the fence may have been recycled
+		return true;
+	}
+
+	return vkGetFenceStatus(m_logicalDevice, it->fence) == VK_SUCCESS;
+}
+
+VkResult IBLLib::vkHelper::acquireFence(VkFence& _outFence)
+{
+	if (m_freeFences.empty() == false)
+	{
+		_outFence = m_freeFences.back();
+		m_freeFences.pop_back();
+		return VK_SUCCESS;
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkResult res = vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &_outFence);
+	if (res != VK_SUCCESS)
+	{
+		printf("Failed to create fence [%u]\n", res);
+		return res;
+	}
+
+	m_fences.push_back(_outFence);
+	return VK_SUCCESS;
+}
+
+VkResult IBLLib::vkHelper::releaseFence(VkFence _fence)
+{
+	VkResult res = vkResetFences(m_logicalDevice, 1u, &_fence);
+	if (res != VK_SUCCESS)
+	{
+		printf("Failed to reset fence [%u]\n", res);
+		return res;
+	}
+
+	m_freeFences.push_back(_fence);
+	return VK_SUCCESS;
 }
 
 VkResult IBLLib::vkHelper::loadShaderModule(VkShaderModule& _outShader, const uint32_t* _spvBlob, size_t _spvBlobByteSize)
@@ -805,15 +1096,69 @@ VkResult IBLLib::vkHelper::createPipeline(VkPipeline& _outPipeline, const VkGrap
 		return VK_RESULT_MAX_ENUM;
 	}
 
+	VkGraphicsPipelineCreateInfo info = *_pCreateInfo;
+
+	VkPipelineCreationFeedbackEXT feedback{};
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+	if (m_pipelineCreationFeedback)
+	{
+		feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+		feedbackInfo.pNext = info.pNext;
+		feedbackInfo.pPipelineCreationFeedback = &feedback;
+		info.pNext = &feedbackInfo;
+	}
+
 	VkResult res = VK_SUCCESS;
 
-	if ((res = vkCreateGraphicsPipelines(m_logicalDevice, m_pipelineCache, 1u, _pCreateInfo, nullptr, &_outPipeline)) != VK_SUCCESS)
+	const auto start = std::chrono::steady_clock::now();
+	if ((res = vkCreateGraphicsPipelines(m_logicalDevice, m_pipelineCache, 1u, &info, nullptr, &_outPipeline)) != VK_SUCCESS)
 	{
 		_outPipeline = VK_NULL_HANDLE;
 		printf("Failed to create pipeline [%u]\n", res);
 		return res;
 	}
 
+	recordPipelineCreation(feedback, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	m_pipelines.emplace_back(_outPipeline);
+
+	return res;
+}
+
+VkResult IBLLib::vkHelper::createComputePipeline(VkPipeline& _outPipeline, VkShaderModule _shaderModule, const char* _entryPoint, VkPipelineLayout _layout)
+{
+	if (m_logicalDevice == VK_NULL_HANDLE)
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	VkComputePipelineCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	info.stage.module = _shaderModule;
+	info.stage.pName = _entryPoint;
+	info.layout = _layout;
+
+	VkPipelineCreationFeedbackEXT feedback{};
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+	if (m_pipelineCreationFeedback)
+	{
+		feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+		feedbackInfo.pPipelineCreationFeedback = &feedback;
+		info.pNext = &feedbackInfo;
+	}
+
+	VkResult res = VK_SUCCESS;
+
+	const auto start = std::chrono::steady_clock::now();
+	if ((res = vkCreateComputePipelines(m_logicalDevice, m_pipelineCache, 1u, &info, nullptr, &_outPipeline)) != VK_SUCCESS)
+	{
+		_outPipeline = VK_NULL_HANDLE;
+		printf("Failed to create compute pipeline [%u]\n", res);
+		return res;
+	}
+
+	recordPipelineCreation(feedback, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
 	m_pipelines.emplace_back(_outPipeline);
 
 	return res;
@@ -849,8 +1194,8 @@ bool IBLLib::vkHelper::getMemoryTypeIndex(const VkMemoryRequirements& _requireme
 
 	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
 	{
-		if ((_requirements.memoryTypeBits & (1 << i)) &&
-			(m_memoryProperties.memoryTypes[i].propertyFlags & _properties))
+		if ((_requirements.memoryTypeBits & (1u << i)) &&
+			(m_memoryProperties.memoryTypes[i].propertyFlags & _properties) == _properties)
 		{
 			_outIndex = i;
 			return true;
@@ -860,7 +1205,7 @@ bool IBLLib::vkHelper::getMemoryTypeIndex(const VkMemoryRequirements& _requireme
 	return false;
 }
 
-VkResult IBLLib::vkHelper::createBufferAndAllocate(VkBuffer& _outBuffer, uint32_t _byteSize, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memoryFlags, VkSharingMode _sharingMode, VkBufferCreateFlags _flags)
+VkResult IBLLib::vkHelper::createBufferAndAllocate(VkBuffer& _outBuffer, VkDeviceSize _byteSize, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memoryFlags, VkSharingMode _sharingMode, VkBufferCreateFlags _flags)
 {
 	if (m_logicalDevice == VK_NULL_HANDLE)
 	{
@@ -886,8 +1231,7 @@ VkResult IBLLib::vkHelper::createBufferAndAllocate(VkBuffer& _outBuffer, uint32_
 		return res;
 	}
 
-	m_buffers.emplace_back();
-	Buffer& buffer = m_buffers.back();
+	Buffer& buffer = m_buffers[_outBuffer];
 
 	buffer.buffer = _outBuffer;
 	buffer.info = bufferInfo;
@@ -895,24 +1239,13 @@ VkResult IBLLib::vkHelper::createBufferAndAllocate(VkBuffer& _outBuffer, uint32_
 	VkMemoryRequirements requirements{};
 	vkGetBufferMemoryRequirements(m_logicalDevice, _outBuffer, &requirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = requirements.size;
-
-	if (getMemoryTypeIndex(requirements, _memoryFlags, allocInfo.memoryTypeIndex) == false)
-	{
-		printf("Unsupported memory requirements [%u]\n", res);
-		return res;
-	}
-
-	if ((res = vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &buffer.memory)) != VK_SUCCESS)
+	if ((res = allocateMemory(requirements, _memoryFlags, true, buffer.allocation)) != VK_SUCCESS)
 	{
 		printf("Failed to allocate buffer [%u]\n", res);
 		return res;
 	}
 
-	if ((res = vkBindBufferMemory(m_logicalDevice, _outBuffer, buffer.memory, 0u)) != VK_SUCCESS)
+	if ((res = vkBindBufferMemory(m_logicalDevice, _outBuffer, buffer.allocation.memory, buffer.allocation.offset)) != VK_SUCCESS)
 	{
 		printf("Failed to bind buffer memory [%u]\n", res);
 	}
@@ -924,19 +1257,17 @@ void IBLLib::vkHelper::destroyBuffer(VkBuffer _buffer)
 {
 	if (m_logicalDevice != VK_NULL_HANDLE)
 	{
-		for (auto it = m_buffers.begin(), end = m_buffers.end(); it != end; ++it)
+		auto it = m_buffers.find(_buffer);
+		if (it != m_buffers.end())
 		{
-			if (it->buffer == _buffer)
-			{
-				it->destroy(m_logicalDevice);
-				m_buffers.erase(it);
-				break;
-			}
+			it->second.destroy(m_logicalDevice);
+			freeMemory(it->second.allocation);
+			m_buffers.erase(it);
 		}
 	}
 }
 
-VkResult IBLLib::vkHelper::writeBufferData(VkBuffer _buffer, const void* _pData, size_t _bytes)
+VkResult IBLLib::vkHelper::writeBufferData(VkBuffer _buffer, const void* _pData, size_t _bytes, size_t _offset)
 {
 	VkResult res = VK_RESULT_MAX_ENUM;
 
@@ -945,22 +1276,14 @@ VkResult IBLLib::vkHelper::writeBufferData(VkBuffer _buffer, const void* _pData,
 		return res;
 	}
 
-	for (const Buffer& buf : m_buffers)
+	auto it = m_buffers.find(_buffer);
+	if (it != m_buffers.end() && it->second.allocation.mapped != nullptr)
 	{
-		if (buf.buffer == _buffer && buf.memory != VK_NULL_HANDLE)
-		{
-			void* data = nullptr;
-			if ((res = vkMapMemory(m_logicalDevice, buf.memory, 0u, _bytes, 0, &data)) != VK_SUCCESS)
-			{
-				printf("Failed to map buffer memory [%u]\n", res);
-				return res;
-			}
+		const Buffer& buf = it->second;
 
-			// write data
-			memcpy(data, _pData, _bytes);
-			vkUnmapMemory(m_logicalDevice, buf.memory);
-			return res;
-		}
+		// write data
+		memcpy(static_cast<uint8_t*>(buf.allocation.mapped) + _offset, _pData, _bytes);
+		return syncMappedMemory(buf.allocation, _offset, _bytes, false);
 	}
 
 	printf("Not a valid buffer\n");
@@ -977,23 +1300,19 @@ VkResult IBLLib::vkHelper::readBufferData(VkBuffer _buffer, void* _pData, size_t
 		return res;
 	}
 
-	for (const Buffer& buf : m_buffers)
+	auto it = m_buffers.find(_buffer);
+	if (it != m_buffers.end() && it->second.allocation.mapped != nullptr)
 	{
-		if (buf.buffer == _buffer && buf.memory != VK_NULL_HANDLE)
-		{
-			void* data = nullptr;
-			if ((res = vkMapMemory(m_logicalDevice, buf.memory, _offset, _bytes, 0, &data)) != VK_SUCCESS)
-			{
-				printf("Failed to map buffer memory [%u]\n", res);
-				return res;
-			}
-
-			// read data
-			memcpy(_pData, data, _bytes);			
+		const Buffer& buf = it->second;
 
-			vkUnmapMemory(m_logicalDevice, buf.memory);
+		if ((res = syncMappedMemory(buf.allocation, _offset, _bytes, true)) != VK_SUCCESS)
+		{
 			return res;
 		}
+
+		// read data
+		memcpy(_pData, static_cast<const uint8_t*>(buf.allocation.mapped) + _offset, _bytes);
+		return res;
 	}
 
 	printf("Not a valid buffer\n");
@@ -1013,20 +1332,7 @@ VkResult IBLLib::vkHelper::createImage2DAndAllocate(
 	}
 
 	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = _width;
-	imageInfo.extent.height = _height;
-	imageInfo.extent.depth = 1u;
-	imageInfo.mipLevels = _mipLevels;
-	imageInfo.arrayLayers = _arrayLayers;
-	imageInfo.format = _format;
-	imageInfo.tiling = _tiling;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = _usage;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.sharingMode = _sharingMode;
-	imageInfo.flags = _flags;
+	fillImage2DCreateInfo(imageInfo, _width, _height, _format, _usage, _mipLevels, _arrayLayers, _tiling, _sharingMode, _flags);
 
 	VkResult res = VK_RESULT_MAX_ENUM;
 
@@ -1036,8 +1342,7 @@ VkResult IBLLib::vkHelper::createImage2DAndAllocate(
 		return res;
 	}
 
-	m_images.emplace_back();
-	Image& img = m_images.back();
+	Image& img = m_images[_outImage];
 
 	img.image = _outImage;
 	img.info = imageInfo;
@@ -1045,24 +1350,13 @@ VkResult IBLLib::vkHelper::createImage2DAndAllocate(
 	VkMemoryRequirements requirements{};
 	vkGetImageMemoryRequirements(m_logicalDevice, _outImage, &requirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = requirements.size;
-
-	if (getMemoryTypeIndex(requirements, _memoryFlags, allocInfo.memoryTypeIndex) == false)
-	{
-		printf("Unsupported memory requirements [%u]\n", res);
-		return res;
-	}
-
-	if ((res = vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &img.memory)) != VK_SUCCESS)
+	if ((res = allocateMemory(requirements, _memoryFlags, _tiling == VK_IMAGE_TILING_LINEAR, img.allocation)) != VK_SUCCESS)
 	{
 		printf("Failed to allocate image [%u]\n", res);
 		return res;
 	}
 
-	if ((res = vkBindImageMemory(m_logicalDevice, _outImage, img.memory, 0u)) != VK_SUCCESS)
+	if ((res = vkBindImageMemory(m_logicalDevice, _outImage, img.allocation.memory, img.allocation.offset)) != VK_SUCCESS)
 	{
 		printf("Failed to bind image memory [%u]\n", res);
 	}
@@ -1070,39 +1364,135 @@ VkResult IBLLib::vkHelper::createImage2DAndAllocate(
 	return res;
 }
 
-void IBLLib::vkHelper::Image::destroy(VkDevice _device)
+void IBLLib::vkHelper::fillImage2DCreateInfo(VkImageCreateInfo& _imageInfo, uint32_t _width, uint32_t _height,
+	VkFormat _format, VkImageUsageFlags _usage,
+	uint32_t _mipLevels, uint32_t _arrayLayers,
+	VkImageTiling _tiling, VkSharingMode _sharingMode, VkImageCreateFlags _flags) const
 {
-	for (const VkImageView& view : views)
+	_imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	_imageInfo.pNext = nullptr;
+	_imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	_imageInfo.extent.width = _width;
+	_imageInfo.extent.height = _height;
+	_imageInfo.extent.depth = 1u;
+	_imageInfo.mipLevels = _mipLevels;
+	_imageInfo.arrayLayers = _arrayLayers;
+	_imageInfo.format = _format;
+	_imageInfo.tiling = _tiling;
+	_imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	_imageInfo.usage = _usage;
+	_imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	_imageInfo.sharingMode = _sharingMode;
+	_imageInfo.flags = _flags;
+}
+
+VkResult IBLLib::vkHelper::createAliasedImages(std::vector<VkImage>& _outImages, const std::vector<VkImageCreateInfo>& _infos, VkMemoryPropertyFlags _memoryFlags)
+{
+	_outImages.clear();
+
+	if (m_logicalDevice == VK_NULL_HANDLE || _infos.empty())
 	{
-		vkDestroyImageView(_device, view, nullptr);
+		return VK_RESULT_MAX_ENUM;
 	}
-	views.clear();
 
-	if (image != VK_NULL_HANDLE)
+	VkResult res = VK_SUCCESS;
+
+	// the shared range has to satisfy the requirements of every image
+	VkMemoryRequirements combined{};
+	combined.memoryTypeBits = UINT32_MAX;
+	bool linear = false;
+
+	for (const VkImageCreateInfo& info : _infos)
 	{
-		vkDestroyImage(_device, image, nullptr);
-		image = VK_NULL_HANDLE;
+		VkImage image = VK_NULL_HANDLE;
+		if ((res = vkCreateImage(m_logicalDevice, &info, nullptr, &image)) != VK_SUCCESS)
+		{
+			printf("Failed to create image [%u]\n", res);
+			break;
+		}
+
+		Image& img = m_images[image];
+		img.image = image;
+		img.info = info;
+		_outImages.push_back(image);
+
+		VkMemoryRequirements requirements{};
+		vkGetImageMemoryRequirements(m_logicalDevice, image, &requirements);
+
+		combined.size = std::max(combined.size, requirements.size);
+		combined.alignment = std::max(combined.alignment, requirements.alignment);
+		combined.memoryTypeBits &= requirements.memoryTypeBits;
+		linear |= info.tiling == VK_IMAGE_TILING_LINEAR;
 	}
 
-	if (memory != VK_NULL_HANDLE)
+	if (res == VK_SUCCESS && combined.memoryTypeBits == 0u)
 	{
-		vkFreeMemory(_device, memory, nullptr);
-		memory = VK_NULL_HANDLE;
+		printf("Aliased images have no common memory type\n");
+		res = VK_RESULT_MAX_ENUM;
 	}
-}
 
-void IBLLib::vkHelper::Buffer::destroy(VkDevice _device)
-{
-	if (buffer != VK_NULL_HANDLE)
+	uint32_t group = 0u;
+	for (; group < m_aliasGroups.size() && m_aliasGroups[group].imageCount != 0u; ++group) {}
+	if (group == m_aliasGroups.size())
 	{
-		vkDestroyBuffer(_device, buffer, nullptr);
-		buffer = VK_NULL_HANDLE;
+		m_aliasGroups.emplace_back();
+	}
+
+	AliasGroup& aliasGroup = m_aliasGroups[group];
+
+	if (res == VK_SUCCESS && (res = allocateMemory(combined, _memoryFlags, linear, aliasGroup.allocation)) != VK_SUCCESS)
+	{
+		printf("Failed to allocate aliased images [%u]\n", res);
+	}
+
+	for (size_t i = 0; res == VK_SUCCESS && i < _outImages.size(); ++i)
+	{
+		if ((res = vkBindImageMemory(m_logicalDevice, _outImages[i], aliasGroup.allocation.memory, aliasGroup.allocation.offset)) != VK_SUCCESS)
+		{
+			printf("Failed to bind image memory [%u]\n", res);
+		}
+	}
+
+	for (const VkImage& image : _outImages)
+	{
+		m_images[image].aliasGroup = group;
+		aliasGroup.imageCount++;
 	}
 
-	if (memory != VK_NULL_HANDLE)
+	if (res != VK_SUCCESS)
 	{
-		vkFreeMemory(_device, memory, nullptr);
-		memory = VK_NULL_HANDLE;
+		// destroying the last image releases the allocation
+		for (const VkImage& image : _outImages)
+		{
+			destroyImage(image);
+		}
+		_outImages.clear();
+	}
+
+	return res;
+}
+
+void IBLLib::vkHelper::Image::destroy(VkDevice _device)
+{
+	for (const VkImageView& view : views)
+	{
+		vkDestroyImageView(_device, view, nullptr);
+	}
+	views.clear();
+
+	if (image != VK_NULL_HANDLE)
+	{
+		vkDestroyImage(_device, image, nullptr);
+		image = VK_NULL_HANDLE;
+	}
+}
+
+void IBLLib::vkHelper::Buffer::destroy(VkDevice _device)
+{
+	if (buffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(_device, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
 	}
 }
 
@@ -1110,14 +1500,30 @@ void IBLLib::vkHelper::destroyImage(VkImage _image)
 {
 	if (m_logicalDevice != VK_NULL_HANDLE)
 	{
-		for (auto it = m_images.begin(), end = m_images.end(); it != end; ++it)
+		auto it = m_images.find(_image);
+		if (it != m_images.end())
 		{
-			if (it->image == _image)
+			for (const VkImageView& view : it->second.views)
 			{
-				it->destroy(m_logicalDevice);
-				m_images.erase(it);
-				break;
+				m_imageViews.erase(view);
 			}
+
+			it->second.destroy(m_logicalDevice);
+
+			if (it->second.aliasGroup < m_aliasGroups.size())
+			{
+				AliasGroup& group = m_aliasGroups[it->second.aliasGroup];
+				if (--group.imageCount == 0u)
+				{
+					freeMemory(group.allocation);
+				}
+			}
+			else
+			{
+				freeMemory(it->second.allocation);
+			}
+
+			m_images.erase(it);
 		}
 	}
 }
@@ -1129,90 +1535,421 @@ VkResult IBLLib::vkHelper::createImageView(VkImageView& _outView, VkImage _image
 		return VK_RESULT_MAX_ENUM;
 	}
 
-	for (Image& img : m_images)
+	auto it = m_images.find(_image);
+	if (it == m_images.end())
 	{
-		if (img.image == _image)
-		{
-			VkImageViewCreateInfo info{};
-			info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			info.pNext = nullptr;
-			info.format = _format == VK_FORMAT_UNDEFINED ? img.info.format : _format;
-			info.flags = 0u;
-			info.image = _image;
-			info.components = _swizzle;
-			info.viewType = _type;
-			info.subresourceRange = _range;
+		return VK_RESULT_MAX_ENUM;
+	}
 
-			VkResult res = vkCreateImageView(m_logicalDevice, &info, nullptr, &_outView);
+	Image& img = it->second;
 
-			if (res == VK_SUCCESS)
-			{
-				img.views.emplace_back(_outView);			
-			}
-			else
+	VkImageViewCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	info.pNext = nullptr;
+	info.format = _format == VK_FORMAT_UNDEFINED ? img.info.format : _format;
+	info.flags = 0u;
+	info.image = _image;
+	info.components = _swizzle;
+	info.viewType = _type;
+	info.subresourceRange = _range;
+
+	VkResult res = vkCreateImageView(m_logicalDevice, &info, nullptr, &_outView);
+
+	if (res == VK_SUCCESS)
+	{
+		img.views.emplace_back(_outView);
+		m_imageViews.emplace(_outView, _image);
+	}
+	else
+	{
+		printf("Failed to create image view [%u]\n", res);
+	}
+
+	return res;
+}
+
+void IBLLib::vkHelper::destroyImageView(VkImageView _view)
+{
+	if (m_logicalDevice != VK_NULL_HANDLE)
+	{
+		auto it = m_imageViews.find(_view);
+		if (it != m_imageViews.end())
+		{
+			auto img = m_images.find(it->second);
+			if (img != m_images.end())
 			{
-				printf("Failed to create image view [%u]\n", res);
+				std::vector<VkImageView>& views = img->second.views;
+				views.erase(std::remove(views.begin(), views.end(), _view), views.end());
 			}
 
-			return res;
+			vkDestroyImageView(m_logicalDevice, _view, nullptr);
+			m_imageViews.erase(it);
 		}
 	}
+}
+
+VkResult IBLLib::vkHelper::uploadImageStreamed(VkImage _image, const RowWriter& _writeRows, VkDeviceSize _chunkByteSize, uint32_t _chunkCount)
+{
+	const VkImageCreateInfo* pInfo = getCreateInfo(_image);
+	if (pInfo == nullptr || pInfo->arrayLayers != 1u)
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
 
-	return VK_RESULT_MAX_ENUM;
+	const auto writeRows = [&](uint32_t /*_level*/, uint32_t /*_layer*/, uint32_t _firstRow, uint32_t _rowCount, void* _dst) -> bool
+	{
+		return _writeRows(_firstRow, _rowCount, _dst);
+	};
+
+	return uploadMipChainStreamed(_image, writeRows, 1u, _chunkByteSize, _chunkCount);
 }
 
-void IBLLib::vkHelper::copyBufferToBasicImage2D(VkCommandBuffer _cmdBuffer, VkBuffer _src, VkImage _dst) const
+VkResult IBLLib::vkHelper::uploadMipChainStreamed(VkImage _image, const SubresourceRowWriter& _writeRows, uint32_t _levelCount, VkDeviceSize _chunkByteSize, uint32_t _chunkCount)
 {
-	for (const Image& img : m_images)
+	if (m_logicalDevice == VK_NULL_HANDLE || _chunkCount == 0u)
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	auto it = m_images.find(_image);
+	if (it == m_images.end())
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	const VkImageCreateInfo info = it->second.info;
+	const VkDeviceSize texelSize = getFormatSize(info.format);
+	const VkDeviceSize rowPitch = static_cast<VkDeviceSize>(info.extent.width) * texelSize;
+	const uint32_t height = info.extent.height;
+
+	if (rowPitch == 0u || height == 0u || _levelCount == 0u || _levelCount > info.mipLevels)
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	// a chunk holds at least one row of mip 0
+	const uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(height, std::max<VkDeviceSize>(1u, _chunkByteSize / rowPitch)));
+	const VkDeviceSize chunkByteSize = rowsPerChunk * rowPitch;
+
+	// copy offsets have to be multiples of 4 and of the texel size
+	const VkDeviceSize offsetAlignment = texelSize * 4u;
+
+	// rows of one subresource that are copied from one chunk
+	struct Segment
+	{
+		uint32_t level;
+		uint32_t layer;
+		uint32_t firstRow;
+		uint32_t rowCount;
+		VkDeviceSize offset;
+	};
+
+	// the subresources are split into segments up front, small mip levels share a chunk
+	std::vector<std::vector<Segment>> batches;
+	VkDeviceSize batchByteSize = chunkByteSize;
+
+	for (uint32_t level = 0u; level < _levelCount; ++level)
+	{
+		const uint32_t levelWidth = std::max(1u, info.extent.width >> level);
+		const uint32_t levelHeight = std::max(1u, height >> level);
+		const VkDeviceSize levelPitch = levelWidth * texelSize;
+		const uint32_t levelRowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(levelHeight, chunkByteSize / levelPitch));
+
+		for (uint32_t layer = 0u; layer < info.arrayLayers; ++layer)
+		{
+			for (uint32_t firstRow = 0u; firstRow < levelHeight; firstRow += levelRowsPerChunk)
+			{
+				const uint32_t rowCount = std::min(levelRowsPerChunk, levelHeight - firstRow);
+				VkDeviceSize offset = (batchByteSize + offsetAlignment - 1u) / offsetAlignment * offsetAlignment;
+
+				if (offset + rowCount * levelPitch > chunkByteSize)
+				{
+					batches.emplace_back();
+					offset = 0u;
+				}
+
+				batches.back().push_back({ level, layer, firstRow, rowCount, offset });
+				batchByteSize = offset + rowCount * levelPitch;
+			}
+		}
+	}
+
+	const uint32_t chunkCount = std::min(_chunkCount, static_cast<uint32_t>(batches.size()));
+	const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, info.mipLevels, 0u, info.arrayLayers };
+
+	std::vector<PendingTransfer> chunks(chunkCount);
+	std::vector<VkBufferImageCopy> regions;
+	VkResult res = VK_SUCCESS;
+
+	VkCommandBufferAllocateInfo cmdBufferInfo{};
+	cmdBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmdBufferInfo.commandPool = m_transferCommandPool;
+	cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmdBufferInfo.commandBufferCount = 1u;
+
+	for (PendingTransfer& chunk : chunks)
+	{
+		if ((res = createBufferAndAllocate(chunk.buffer, chunkByteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		if ((res = vkAllocateCommandBuffers(m_logicalDevice, &cmdBufferInfo, &chunk.cmdBuffer)) != VK_SUCCESS)
+		{
+			printf("Failed to allocate command buffers [%u]\n", res);
+			chunk.cmdBuffer = VK_NULL_HANDLE;
+			break;
+		}
+
+		if ((res = acquireFence(chunk.fence)) != VK_SUCCESS)
+		{
+			break;
+		}
+	}
+
+	// ownership of the image moves from the transfer to the graphics queue family with a release barrier after the
+	// last copy and a matching acquire barrier in front of the next graphics submission, which waits for semaphore
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	VkCommandBuffer acquireCmdBuffer = VK_NULL_HANDLE;
+	VkImageMemoryBarrier ownershipBarrier{};
+
+	if (res == VK_SUCCESS && hasTransferQueue())
+	{
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if ((res = vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &semaphore)) != VK_SUCCESS)
+		{
+			printf("Failed to create semaphore [%u]\n", res);
+		}
+		else
+		{
+			res = createCommandBuffer(acquireCmdBuffer);
+		}
+
+		ownershipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		ownershipBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		ownershipBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		ownershipBarrier.srcQueueFamilyIndex = m_transferQueueFamilyIndex;
+		ownershipBarrier.dstQueueFamilyIndex = m_queueFamilyIndex;
+		ownershipBarrier.image = _image;
+		ownershipBarrier.subresourceRange = range;
+	}
+
+	if (acquireCmdBuffer != VK_NULL_HANDLE && res == VK_SUCCESS)
+	{
+		// srcAccessMask of an acquire is ignored, barriers recorded after it wait for the transfer stage
+		ownershipBarrier.srcAccessMask = 0u;
+		ownershipBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		if ((res = beginCommandBuffer(acquireCmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) == VK_SUCCESS)
+		{
+			vkCmdPipelineBarrier(acquireCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0u,
+				0u, nullptr, 0u, nullptr, 1u, &ownershipBarrier);
+			res = endCommandBuffer(acquireCmdBuffer);
+		}
+	}
+
+	for (size_t batchIndex = 0u; res == VK_SUCCESS && batchIndex < batches.size(); ++batchIndex)
 	{
-		if (img.image == _dst)
+		PendingTransfer& chunk = chunks[batchIndex % chunkCount];
+		const bool lastBatch = batchIndex + 1u == batches.size();
+
+		// wait for the copy that used this staging buffer last
+		if (chunk.pending)
 		{
+			if ((res = vkWaitForFences(m_logicalDevice, 1u, &chunk.fence, VK_TRUE, UINT64_MAX)) != VK_SUCCESS ||
+				(res = vkResetFences(m_logicalDevice, 1u, &chunk.fence)) != VK_SUCCESS)
+			{
+				printf("Failed to wait for fence [%u]\n", res);
+				break;
+			}
+			chunk.pending = false;
+		}
+
+		const Allocation& allocation = m_buffers[chunk.buffer].allocation;
+		VkDeviceSize usedBytes = 0u;
+		regions.clear();
+
+		for (const Segment& segment : batches[batchIndex])
+		{
+			const uint32_t levelWidth = std::max(1u, info.extent.width >> segment.level);
+
+			if (_writeRows(segment.level, segment.layer, segment.firstRow, segment.rowCount, static_cast<uint8_t*>(allocation.mapped) + segment.offset) == false)
+			{
+				printf("Failed to fill upload rows %u to %u of level %u layer %u\n", segment.firstRow, segment.firstRow + segment.rowCount, segment.level, segment.layer);
+				res = VK_RESULT_MAX_ENUM;
+				break;
+			}
+
 			VkBufferImageCopy region{};
-			region.bufferOffset = 0u;
-			region.bufferRowLength = 0u;
-			region.bufferImageHeight = 0u;
+			region.bufferOffset = segment.offset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, segment.level, segment.layer, 1u };
+			region.imageOffset = { 0, static_cast<int32_t>(segment.firstRow), 0 };
+			region.imageExtent = { levelWidth, segment.rowCount, 1u };
+			regions.push_back(region);
+
+			usedBytes = segment.offset + segment.rowCount * levelWidth * texelSize;
+		}
+
+		if (res != VK_SUCCESS ||
+			(res = syncMappedMemory(allocation, 0u, usedBytes, false)) != VK_SUCCESS ||
+			(res = beginCommandBuffer(chunk.cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)) != VK_SUCCESS)
+		{
+			break;
+		}
 
-			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			region.imageSubresource.mipLevel = 0u;
-			region.imageSubresource.baseArrayLayer = 0u;
-			region.imageSubresource.layerCount = img.info.arrayLayers;// 1u;
+		if (batchIndex == 0u)
+		{
+			// later chunks are submitted after this one, the barrier covers their copies as well
+			imageBarrier(chunk.cmdBuffer, _image,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0u,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				range);
+		}
 
-			region.imageOffset = { 0, 0, 0 };
-			region.imageExtent = img.info.extent;
+		vkCmdCopyBufferToImage(chunk.cmdBuffer, chunk.buffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		// release after the copies of all chunks, they were submitted to the same queue before
+		if (lastBatch && semaphore != VK_NULL_HANDLE)
+		{
+			ownershipBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			ownershipBarrier.dstAccessMask = 0u;
 
-			vkCmdCopyBufferToImage(_cmdBuffer, _src, _dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &region);
-			return;
+			vkCmdPipelineBarrier(chunk.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u,
+				0u, nullptr, 0u, nullptr, 1u, &ownershipBarrier);
 		}
+
+		if ((res = endCommandBuffer(chunk.cmdBuffer)) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1u;
+		submitInfo.pCommandBuffers = &chunk.cmdBuffer;
+		submitInfo.signalSemaphoreCount = lastBatch && semaphore != VK_NULL_HANDLE ? 1u : 0u;
+		submitInfo.pSignalSemaphores = &semaphore;
+
+		if ((res = vkQueueSubmit(m_transferQueue, 1u, &submitInfo, chunk.fence)) != VK_SUCCESS)
+		{
+			printf("Failed to submit queue [%d].\n", res);
+			break;
+		}
+
+		chunk.pending = true;
 	}
+
+	// the last chunks are still copying, they are released after the next graphics submission
+	m_pendingTransfers.insert(m_pendingTransfers.end(), chunks.begin(), chunks.end());
+
+	if (res == VK_SUCCESS)
+	{
+		if (semaphore != VK_NULL_HANDLE)
+		{
+			m_transferSemaphores.push_back(semaphore);
+			m_acquireCmdBuffers.push_back(acquireCmdBuffer);
+		}
+	}
+	else
+	{
+		retireTransfers(m_pendingTransfers);
+
+		// the semaphore was not signaled if the last chunk failed
+		if (semaphore != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
+		}
+
+		if (acquireCmdBuffer != VK_NULL_HANDLE)
+		{
+			destroyCommandBuffer(acquireCmdBuffer);
+		}
+	}
+
+	if (m_debugOutputEnabled && res == VK_SUCCESS)
+	{
+		printf("Streamed %u levels x %u layers in %u chunks of %u rows\n", _levelCount, info.arrayLayers, static_cast<uint32_t>(batches.size()), rowsPerChunk);
+	}
+
+	return res;
 }
 
-void IBLLib::vkHelper::copyImage2DToBuffer(VkCommandBuffer _cmdBuffer, VkImage _src, VkBuffer _dst, VkImageSubresourceLayers _imageSubresource) const
+void IBLLib::vkHelper::retireTransfers(std::vector<PendingTransfer>& _transfers)
 {
-	for (const Image& img : m_images)
+	for (PendingTransfer& transfer : _transfers)
 	{
-		if (img.image == _src)
+		if (transfer.pending)
 		{
-			VkBufferImageCopy region{};
-			region.bufferOffset = 0u;
-			region.bufferRowLength = 0u;
-			region.bufferImageHeight = 0u;
-
-			region.imageSubresource = _imageSubresource;
+			vkWaitForFences(m_logicalDevice, 1u, &transfer.fence, VK_TRUE, UINT64_MAX);
+		}
 
-			region.imageOffset = { 0, 0, 0 };
-			region.imageExtent = img.info.extent;
-		
-			vkCmdCopyImageToBuffer(_cmdBuffer, _src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				_dst,	//	VkBuffer
-				1u,		//	uint32_t  regionCount,
-				&region	//	const VkBufferImageCopy* pRegions);
-				);
+		if (transfer.fence != VK_NULL_HANDLE)
+		{
+			releaseFence(transfer.fence);
+		}
 
-			return;
+		if (transfer.cmdBuffer != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(m_logicalDevice, m_transferCommandPool, 1u, &transfer.cmdBuffer);
 		}
+
+		destroyBuffer(transfer.buffer);
+	}
+
+	_transfers.clear();
+}
+
+void IBLLib::vkHelper::copyBufferToBasicImage2D(VkCommandBuffer _cmdBuffer, VkBuffer _src, VkImage _dst) const
+{
+	auto it = m_images.find(_dst);
+	if (it != m_images.end())
+	{
+		const Image& img = it->second;
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0u;
+		region.bufferRowLength = 0u;
+		region.bufferImageHeight = 0u;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0u;
+		region.imageSubresource.baseArrayLayer = 0u;
+		region.imageSubresource.layerCount = img.info.arrayLayers;// 1u;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = img.info.extent;
+
+		vkCmdCopyBufferToImage(_cmdBuffer, _src, _dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &region);
+	}
+}
+
+void IBLLib::vkHelper::copyImage2DToBuffer(VkCommandBuffer _cmdBuffer, VkImage _src, VkBuffer _dst, VkImageSubresourceLayers _imageSubresource) const
+{
+	auto it = m_images.find(_src);
+	if (it == m_images.end())
+	{
+		printf("image not found\n");
+		return;
 	}
 
-	printf("image not found\n");
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0u;
+	region.bufferRowLength = 0u;
+	region.bufferImageHeight = 0u;
+
+	region.imageSubresource = _imageSubresource;
+
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = it->second.info.extent;
+
+	vkCmdCopyImageToBuffer(_cmdBuffer, _src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		_dst,	//	VkBuffer
+		1u,		//	uint32_t  regionCount,
+		&region	//	const VkBufferImageCopy* pRegions);
+		);
 }
 
 void IBLLib::vkHelper::copyImage2DToBuffer(VkCommandBuffer _cmdBuffer, VkImage _src, VkBuffer _dst, const VkBufferImageCopy& _region) const
@@ -1277,22 +2014,29 @@ VkResult IBLLib::vkHelper::createFramebuffer(VkFramebuffer& _outFramebuffer, VkR
 		return res;
 	}
 
-	m_frameBuffers.emplace_back(_outFramebuffer);
+	m_frameBuffers.insert(_outFramebuffer);
 
 	return res;
 }
 
 VkResult IBLLib::vkHelper::createFramebuffer(VkFramebuffer& _outFramebuffer, VkRenderPass _renderPass, VkImage _image)
 {
-	for (const Image& img : m_images)
+	auto it = m_images.find(_image);
+	if (it == m_images.end())
 	{
-		if (img.image == _image)
-		{
-			return createFramebuffer(_outFramebuffer, _renderPass, img.info.extent.width, img.info.extent.height, img.views, img.info.arrayLayers);
-		}
+		return VK_RESULT_MAX_ENUM;
 	}
 
-	return VK_RESULT_MAX_ENUM;
+	const Image& img = it->second;
+	return createFramebuffer(_outFramebuffer, _renderPass, img.info.extent.width, img.info.extent.height, img.views, img.info.arrayLayers);
+}
+
+void IBLLib::vkHelper::destroyFramebuffer(VkFramebuffer _framebuffer)
+{
+	if (m_logicalDevice != VK_NULL_HANDLE && m_frameBuffers.erase(_framebuffer) != 0u)
+	{
+		vkDestroyFramebuffer(m_logicalDevice, _framebuffer, nullptr);
+	}
 }
 
 void IBLLib::vkHelper::beginRenderPass(VkCommandBuffer _cmdBuffer, VkRenderPass _renderPass, VkFramebuffer _framebuffer, const VkRect2D& _area, const std::vector<VkClearValue>& _clearValues, VkSubpassContents _contents) const
@@ -1358,15 +2102,503 @@ VkResult IBLLib::vkHelper::createSampler(VkSampler& _outSampler, VkSamplerCreate
 
 const VkImageCreateInfo* IBLLib::vkHelper::getCreateInfo(const VkImage _image)
 {
-	for (const Image& img : m_images)
+	auto it = m_images.find(_image);
+	return it != m_images.end() ? &it->second.info : nullptr;
+}
+
+VkResult IBLLib::vkHelper::createTimestampQueryPool(VkQueryPool& _outPool, uint32_t _queryCount)
+{
+	if (m_logicalDevice == VK_NULL_HANDLE || supportsTimestamps() == false)
 	{
-		if (img.image == _image)
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	VkResult res = VK_SUCCESS;
+
+	VkQueryPoolCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	info.queryCount = _queryCount;
+
+	if ((res = vkCreateQueryPool(m_logicalDevice, &info, nullptr, &_outPool)) != VK_SUCCESS)
+	{
+		printf("Failed to create query pool [%u]\n", res);
+	}
+	else
+	{
+		m_queryPools.emplace_back(_outPool);
+	}
+
+	return res;
+}
+
+VkResult IBLLib::vkHelper::getTimestamps(VkQueryPool _pool, uint32_t _queryCount, std::vector<double>& _outMilliseconds) const
+{
+	if (m_logicalDevice == VK_NULL_HANDLE)
+	{
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	VkResult res = VK_SUCCESS;
+
+	std::vector<uint64_t> ticks(_queryCount);
+	if ((res = vkGetQueryPoolResults(m_logicalDevice, _pool, 0u, _queryCount, ticks.size() * sizeof(uint64_t), ticks.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT)) != VK_SUCCESS)
+	{
+		printf("Failed to read timestamps [%u]\n", res);
+		return res;
+	}
+
+	// the counter wraps at timestampValidBits, timestampPeriod is in nanoseconds per tick
+	const uint64_t mask = m_timestampValidBits >= 64u ? ~0ull : (1ull << m_timestampValidBits) - 1ull;
+	const double millisecondsPerTick = m_deviceProperties.limits.timestampPeriod / 1000000.0;
+
+	_outMilliseconds.resize(_queryCount);
+	for (uint32_t i = 0u; i < _queryCount; ++i)
+	{
+		_outMilliseconds[i] = static_cast<double>((ticks[i] - ticks[0]) & mask) * millisecondsPerTick;
+	}
+
+	return res;
+}
+
+bool IBLLib::vkHelper::isFormatSupported(VkFormat _format, VkFormatFeatureFlags _features) const
+{
+	if (m_physicalDevice == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	VkFormatProperties properties{};
+	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, _format, &properties);
+
+	return (properties.optimalTilingFeatures & _features) == _features;
+}
+
+IBLLib::vkHelper::MemoryStatistics IBLLib::vkHelper::getMemoryStatistics() const
+{
+	MemoryStatistics stats = m_memoryStatistics;
+
+	VkDeviceSize freeBytes = 0u;
+	for (const MemoryBlock& block : m_memoryBlocks)
+	{
+		for (const MemoryBlock::Range& range : block.freeRanges)
+		{
+			freeBytes += range.size;
+			stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+		}
+	}
+
+	stats.fragmentation = freeBytes > 0u ? 1.f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes) : 0.f;
+
+	return stats;
+}
+
+std::vector<IBLLib::vkHelper::MemoryHeapBudget> IBLLib::vkHelper::getMemoryBudget() const
+{
+	std::vector<MemoryHeapBudget> heaps(m_memoryProperties.memoryHeapCount);
+
+	for (uint32_t i = 0u; i < m_memoryProperties.memoryHeapCount; ++i)
+	{
+		heaps[i].size = m_memoryProperties.memoryHeaps[i].size;
+		heaps[i].budget = heaps[i].size;
+		heaps[i].deviceLocal = (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0u;
+	}
+
+	if (m_memoryBudget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget;
+
+		m_getMemoryProperties2(m_physicalDevice, &properties);
+
+		for (uint32_t i = 0u; i < m_memoryProperties.memoryHeapCount; ++i)
+		{
+			heaps[i].budget = budget.heapBudget[i];
+			heaps[i].usage = budget.heapUsage[i];
+		}
+	}
+	else
+	{
+		for (const MemoryTypeStatistics& type : m_memoryStatistics.memoryTypes)
 		{
-			return &img.info;
+			heaps[type.heapIndex].usage += type.blockBytes;
 		}
 	}
 
-	return nullptr;
+	return heaps;
+}
+
+bool IBLLib::vkHelper::isPipelineCacheCompatible(const void* _data, size_t _bytes) const
+{
+	VkPipelineCacheHeaderVersionOne header{};
+	if (_data == nullptr || _bytes < sizeof(header))
+	{
+		return false;
+	}
+
+	memcpy(&header, _data, sizeof(header));
+
+	return header.headerSize >= sizeof(header) && header.headerSize <= _bytes &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == m_deviceProperties.vendorID &&
+		header.deviceID == m_deviceProperties.deviceID &&
+		memcmp(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void IBLLib::vkHelper::storePipelineCache()
+{
+	// held until the file is replaced, so a process finishing at the same time merges our pipelines instead of dropping them
+	FileLock lock;
+	if (lock.lock((m_pipelineCachePath + ".lock").c_str()) == false)
+	{
+		return;
+	}
+
+	{
+		MappedFile current;
+		if (mapExistingFile(current, m_pipelineCachePath) && isPipelineCacheCompatible(current.getData(), current.getSize()))
+		{
+			VkPipelineCacheCreateInfo info{};
+			info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			info.initialDataSize = current.getSize();
+			info.pInitialData = current.getData();
+
+			VkPipelineCache other = VK_NULL_HANDLE;
+			if (vkCreatePipelineCache(m_logicalDevice, &info, nullptr, &other) == VK_SUCCESS)
+			{
+				vkMergePipelineCaches(m_logicalDevice, m_pipelineCache, 1u, &other);
+				vkDestroyPipelineCache(m_logicalDevice, other, nullptr);
+			}
+		}
+	}
+
+	size_t bytes = 0u;
+	if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &bytes, nullptr) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	std::vector<char> cache(bytes);
+	if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &bytes, cache.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	if (writeFileAtomic(m_pipelineCachePath.c_str(), cache.data(), bytes))
+	{
+		printf("Stored %s [%zukb]\n", m_pipelineCachePath.c_str(), bytes / 1000u);
+	}
+}
+
+void IBLLib::vkHelper::recordPipelineCreation(const VkPipelineCreationFeedbackEXT& _feedback, double _milliseconds)
+{
+	m_pipelineCacheStatistics.creationMilliseconds += _milliseconds;
+
+	if ((_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) == 0u)
+	{
+		++m_pipelineCacheStatistics.unreported;
+	}
+	else if (_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+	{
+		++m_pipelineCacheStatistics.hits;
+	}
+	else
+	{
+		++m_pipelineCacheStatistics.misses;
+	}
+}
+
+VkResult IBLLib::vkHelper::allocateMemory(const VkMemoryRequirements& _requirements, VkMemoryPropertyFlags _properties, bool _linear, Allocation& _outAllocation)
+{
+	uint32_t memoryTypeIndex = 0u;
+	if (getMemoryTypeIndex(_requirements, _properties, memoryTypeIndex) == false)
+	{
+		printf("Unsupported memory requirements\n");
+		return VK_RESULT_MAX_ENUM;
+	}
+
+	const VkMemoryType& memoryType = m_memoryProperties.memoryTypes[memoryTypeIndex];
+	VkDeviceSize blockSize = (memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? g_HostVisibleBlockSize : g_DeviceLocalBlockSize;
+	blockSize = std::min(blockSize, m_memoryProperties.memoryHeaps[memoryType.heapIndex].size / 8u);
+
+	const VkDeviceSize alignment = std::max<VkDeviceSize>(_requirements.alignment, 1u);
+
+	VkResult res = VK_SUCCESS;
+	uint32_t blockIndex = UINT32_MAX;
+	VkDeviceSize offset = 0u;
+
+	// large resources get a block of their own, everything else is packed into shared blocks
+	if (_requirements.size > blockSize / 2u)
+	{
+		if ((res = createMemoryBlock(memoryTypeIndex, _requirements.size, _linear, true, blockIndex)) != VK_SUCCESS)
+		{
+			return res;
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0u; i < m_memoryBlocks.size() && blockIndex == UINT32_MAX; ++i)
+		{
+			const MemoryBlock& block = m_memoryBlocks[i];
+			if (block.memory == VK_NULL_HANDLE || block.dedicated || block.linear != _linear || block.memoryTypeIndex != memoryTypeIndex)
+			{
+				continue;
+			}
+
+			for (const MemoryBlock::Range& range : block.freeRanges)
+			{
+				const VkDeviceSize alignedOffset = (range.offset + alignment - 1u) / alignment * alignment;
+				if (alignedOffset + _requirements.size <= range.offset + range.size)
+				{
+					blockIndex = i;
+					break;
+				}
+			}
+		}
+
+		if (blockIndex == UINT32_MAX)
+		{
+			if ((res = createMemoryBlock(memoryTypeIndex, blockSize, _linear, false, blockIndex)) != VK_SUCCESS)
+			{
+				return res;
+			}
+		}
+	}
+
+	// first fit, padding in front of the aligned offset stays in the free list
+	MemoryBlock& block = m_memoryBlocks[blockIndex];
+	for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it)
+	{
+		const VkDeviceSize alignedOffset = (it->offset + alignment - 1u) / alignment * alignment;
+		const VkDeviceSize rangeEnd = it->offset + it->size;
+
+		if (alignedOffset + _requirements.size > rangeEnd)
+		{
+			continue;
+		}
+
+		offset = alignedOffset;
+		const VkDeviceSize tailOffset = alignedOffset + _requirements.size;
+
+		if (alignedOffset > it->offset)
+		{
+			it->size = alignedOffset - it->offset;
+			if (tailOffset < rangeEnd)
+			{
+				block.freeRanges.insert(it + 1, { tailOffset, rangeEnd - tailOffset });
+			}
+		}
+		else if (tailOffset < rangeEnd)
+		{
+			it->offset = tailOffset;
+			it->size = rangeEnd - tailOffset;
+		}
+		else
+		{
+			block.freeRanges.erase(it);
+		}
+		break;
+	}
+
+	block.usedBytes += _requirements.size;
+	block.allocationCount++;
+
+	_outAllocation.memory = block.memory;
+	_outAllocation.offset = offset;
+	_outAllocation.size = _requirements.size;
+	_outAllocation.block = blockIndex;
+	_outAllocation.mapped = block.mapped != nullptr ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+
+	m_memoryStatistics.allocationCount++;
+	m_memoryStatistics.usedBytes += _requirements.size;
+	m_memoryStatistics.peakUsedBytes = std::max(m_memoryStatistics.peakUsedBytes, m_memoryStatistics.usedBytes);
+
+	MemoryTypeStatistics& typeStats = m_memoryStatistics.memoryTypes[block.memoryTypeIndex];
+	typeStats.usedBytes += _requirements.size;
+	typeStats.peakUsedBytes = std::max(typeStats.peakUsedBytes, typeStats.usedBytes);
+
+	return res;
+}
+
+void IBLLib::vkHelper::freeMemory(Allocation& _allocation)
+{
+	if (_allocation.block >= m_memoryBlocks.size())
+	{
+		return;
+	}
+
+	MemoryBlock& block = m_memoryBlocks[_allocation.block];
+	std::vector<MemoryBlock::Range>& ranges = block.freeRanges;
+
+	auto it = std::lower_bound(ranges.begin(), ranges.end(), _allocation.offset,
+		[](const MemoryBlock::Range& _range, VkDeviceSize _offset) { return _range.offset < _offset; });
+	it = ranges.insert(it, { _allocation.offset, _allocation.size });
+
+	// merge with neighbours
+	if (it + 1 != ranges.end() && it->offset + it->size == (it + 1)->offset)
+	{
+		it->size += (it + 1)->size;
+		ranges.erase(it + 1);
+	}
+	if (it != ranges.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+	{
+		(it - 1)->size += it->size;
+		ranges.erase(it);
+	}
+
+	block.usedBytes -= _allocation.size;
+	block.allocationCount--;
+
+	m_memoryStatistics.allocationCount--;
+	m_memoryStatistics.usedBytes -= _allocation.size;
+	m_memoryStatistics.memoryTypes[block.memoryTypeIndex].usedBytes -= _allocation.size;
+
+	if (block.allocationCount == 0u)
+	{
+		// keep one empty block per memory type around for the next job
+		bool keep = block.dedicated == false;
+		for (const MemoryBlock& other : m_memoryBlocks)
+		{
+			if (&other != &block && other.memory != VK_NULL_HANDLE && other.allocationCount == 0u && other.dedicated == false &&
+				other.memoryTypeIndex == block.memoryTypeIndex && other.linear == block.linear)
+			{
+				keep = false;
+				break;
+			}
+		}
+
+		if (keep == false)
+		{
+			destroyMemoryBlock(block);
+		}
+	}
+
+	_allocation = {};
+}
+
+VkResult IBLLib::vkHelper::createMemoryBlock(uint32_t _memoryTypeIndex, VkDeviceSize _size, bool _linear, bool _dedicated, uint32_t& _outBlock)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = nullptr;
+	allocInfo.allocationSize = _size;
+	allocInfo.memoryTypeIndex = _memoryTypeIndex;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkResult res = VK_SUCCESS;
+
+	if ((res = vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &memory)) != VK_SUCCESS)
+	{
+		printf("Failed to allocate %llu bytes of device memory [%u]\n", static_cast<unsigned long long>(_size), res);
+		return res;
+	}
+
+	void* mapped = nullptr;
+	if (m_memoryProperties.memoryTypes[_memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if ((res = vkMapMemory(m_logicalDevice, memory, 0u, VK_WHOLE_SIZE, 0u, &mapped)) != VK_SUCCESS)
+		{
+			printf("Failed to map memory block [%u]\n", res);
+			vkFreeMemory(m_logicalDevice, memory, nullptr);
+			return res;
+		}
+	}
+
+	_outBlock = static_cast<uint32_t>(m_memoryBlocks.size());
+	for (uint32_t i = 0u; i < m_memoryBlocks.size(); ++i)
+	{
+		if (m_memoryBlocks[i].memory == VK_NULL_HANDLE)
+		{
+			_outBlock = i;
+			break;
+		}
+	}
+
+	if (_outBlock == m_memoryBlocks.size())
+	{
+		m_memoryBlocks.emplace_back();
+	}
+
+	MemoryBlock& block = m_memoryBlocks[_outBlock];
+	block.memory = memory;
+	block.size = _size;
+	block.usedBytes = 0u;
+	block.memoryTypeIndex = _memoryTypeIndex;
+	block.allocationCount = 0u;
+	block.linear = _linear;
+	block.dedicated = _dedicated;
+	block.mapped = mapped;
+	block.freeRanges = { { 0u, _size } };
+
+	m_memoryStatistics.blockCount++;
+	m_memoryStatistics.deviceAllocationCount++;
+	m_memoryStatistics.blockBytes += _size;
+	m_memoryStatistics.peakBlockBytes = std::max(m_memoryStatistics.peakBlockBytes, m_memoryStatistics.blockBytes);
+
+	MemoryTypeStatistics& typeStats = m_memoryStatistics.memoryTypes[_memoryTypeIndex];
+	typeStats.blockBytes += _size;
+	typeStats.peakBlockBytes = std::max(typeStats.peakBlockBytes, typeStats.blockBytes);
+
+	if (m_debugOutputEnabled)
+	{
+		printf("Allocated %s memory block: %.1f MiB, memory type %u\n", _dedicated ? "dedicated" : "shared", _size / (1024.0 * 1024.0), _memoryTypeIndex);
+	}
+
+	return res;
+}
+
+void IBLLib::vkHelper::destroyMemoryBlock(MemoryBlock& _block)
+{
+	if (_block.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (_block.mapped != nullptr)
+	{
+		vkUnmapMemory(m_logicalDevice, _block.memory);
+	}
+
+	vkFreeMemory(m_logicalDevice, _block.memory, nullptr);
+
+	m_memoryStatistics.blockCount--;
+	m_memoryStatistics.blockBytes -= _block.size;
+	m_memoryStatistics.memoryTypes[_block.memoryTypeIndex].blockBytes -= _block.size;
+
+	_block = {};
+}
+
+VkResult IBLLib::vkHelper::syncMappedMemory(const Allocation& _allocation, VkDeviceSize _offset, VkDeviceSize _bytes, bool _invalidate)
+{
+	const MemoryBlock& block = m_memoryBlocks[_allocation.block];
+	if (m_memoryProperties.memoryTypes[block.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	{
+		return VK_SUCCESS;
+	}
+
+	// ranges have to be aligned to nonCoherentAtomSize
+	const VkDeviceSize atom = std::max<VkDeviceSize>(m_deviceProperties.limits.nonCoherentAtomSize, 1u);
+	const VkDeviceSize begin = (_allocation.offset + _offset) / atom * atom;
+	const VkDeviceSize end = std::min((_allocation.offset + _offset + _bytes + atom - 1u) / atom * atom, block.size);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = block.memory;
+	range.offset = begin;
+	range.size = end - begin;
+
+	VkResult res = _invalidate ? vkInvalidateMappedMemoryRanges(m_logicalDevice, 1u, &range) : vkFlushMappedMemoryRanges(m_logicalDevice, 1u, &range);
+	if (res != VK_SUCCESS)
+	{
+		printf("Failed to %s mapped memory [%u]\n", _invalidate ? "invalidate" : "flush", res);
+	}
+
+	return res;
 }
 
 const VkSpecializationInfo* IBLLib::SpecConstantFactory::getInfo()
@@ -1415,6 +2647,12 @@ void IBLLib::DescriptorSetInfo::addUniform(VkBuffer _uniform, VkDeviceSize _offs
 	m_resources.emplace_back(_uniform, _offset, _range);
 }
 
+void IBLLib::DescriptorSetInfo::addStorageImage(VkImageView _imageView, VkImageLayout _imageLayout, uint32_t _binding, VkShaderStageFlags _stages)
+{
+	addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1u, _stages, _binding);
+	m_resources.emplace_back(VK_NULL_HANDLE, _imageView, _imageLayout);
+}
+
 VkResult IBLLib::DescriptorSetInfo::create(vkHelper& _instance, std::vector<VkDescriptorSetLayout>& _outLayouts, std::vector<VkDescriptorSet>& _outDescriptorSets)
 {
 	_outLayouts.emplace_back();
@@ -2,6 +2,10 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace IBLLib
 {
@@ -10,10 +14,54 @@ namespace IBLLib
 		friend class DescriptorSetInfo;
 
 	public:
+		struct MemoryTypeStatistics
+		{
+			VkMemoryPropertyFlags flags = 0u;
+			uint32_t heapIndex = 0u;
+			VkDeviceSize blockBytes = 0u;
+			VkDeviceSize usedBytes = 0u;
+			VkDeviceSize peakBlockBytes = 0u;
+			VkDeviceSize peakUsedBytes = 0u;
+		};
+
+		struct MemoryStatistics
+		{
+			uint32_t blockCount = 0u; // live VkDeviceMemory blocks
+			uint32_t allocationCount = 0u; // live sub-allocations
+			uint32_t deviceAllocationCount = 0u; // total vkAllocateMemory calls
+			VkDeviceSize blockBytes = 0u; // bytes held in blocks
+			VkDeviceSize usedBytes = 0u; // bytes sub-allocated to images and buffers
+			VkDeviceSize peakBlockBytes = 0u;
+			VkDeviceSize peakUsedBytes = 0u;
+			VkDeviceSize largestFreeRange = 0u;
+			float fragmentation = 0.f; // 1 - largestFreeRange / free bytes, 0 if all free memory is contiguous
+			std::vector<MemoryTypeStatistics> memoryTypes; // indexed by memory type index
+		};
+
+		struct MemoryHeapBudget
+		{
+			VkDeviceSize size = 0u;
+			VkDeviceSize budget = 0u; // bytes the process can allocate from the heap, the heap size without VK_EXT_memory_budget
+			VkDeviceSize usage = 0u; // bytes the process allocated from the heap, only blocks of this vkHelper without VK_EXT_memory_budget
+			bool deviceLocal = false;
+		};
+
+		struct PipelineCacheStatistics
+		{
+			uint32_t hits = 0u; // pipelines the driver found in the cache, needs VK_EXT_pipeline_creation_feedback
+			uint32_t misses = 0u;
+			uint32_t unreported = 0u; // pipelines created without creation feedback
+			double creationMilliseconds = 0.0; // total time spent in vkCreate*Pipelines
+			size_t loadedBytes = 0u; // 0 if no cache file was found or it was rejected
+			bool rejected = false; // the cache file was written by another device, driver or is corrupt
+		};
+
 		vkHelper();
 		~vkHelper();
 
-		VkResult initialize(uint32_t _phyDeviceIndex = 0u, uint32_t _descriptorPoolSizeFactor = 1u, bool _debugOutput = true);
+		// the pipeline cache is loaded from and stored to _pipelineCacheDirectory, in a file named after the device,
+		// driver and pipelineCacheUUID. processes sharing the directory merge their caches. nullptr keeps the cache in memory
+		VkResult initialize(uint32_t _phyDeviceIndex = 0u, uint32_t _descriptorPoolSizeFactor = 1u, bool _debugOutput = true, const char* _pipelineCacheDirectory = nullptr);
 
 		void shutdown();
 
@@ -32,10 +80,23 @@ namespace IBLLib
 
 		VkResult endCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers) const;
 
-		VkResult executeCommandBuffer(VkCommandBuffer _cmdBuffer) const;
+		VkResult executeCommandBuffer(VkCommandBuffer _cmdBuffer);
 
-		// make sure there are no dependencies between command buffers. this method is blocking
-		VkResult executeCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers) const;
+		// make sure there are no dependencies between command buffers. this method is blocking.
+		// waits for the streamed uploads submitted before and acquires their images from the transfer queue
+		VkResult executeCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers);
+
+		// submits like executeCommandBuffers without waiting. _outFence comes from a pool and is signaled once the command
+		// buffers completed, it is returned to the pool by waitForSubmission. later submissions execute after this one
+		// in queue order, they only need barriers and no CPU wait in between
+		VkResult submitCommandBuffers(const std::vector<VkCommandBuffer>& _cmdBuffers, VkFence& _outFence);
+
+		// blocks until the submission of _fence completed and releases the fence, call it once per submission
+		VkResult waitForSubmission(VkFence _fence);
+
+		// polls the submission of _fence without blocking. the handle identifies the submission only until
+		// waitForSubmission released it, the fence is reused by later submissions after that
+		bool isSubmissionComplete(VkFence _fence) const;
 
 		VkResult loadShaderModule(VkShaderModule& _outShader, const uint32_t* _spvBlob, size_t _spvBlobByteSize);
 
@@ -69,17 +130,20 @@ namespace IBLLib
 		// pipelines are owned by this vkHelper instance, do not destory manually
 		VkResult createPipeline(VkPipeline& _outPipeline, const VkGraphicsPipelineCreateInfo* _pCreateInfo);
 
+		// pipelines are owned by this vkHelper instance, do not destory manually
+		VkResult createComputePipeline(VkPipeline& _outPipeline, VkShaderModule _shaderModule, const char* _entryPoint, VkPipelineLayout _layout);
+
 		// renderpasses are owned by this vkHelper instance, do not destory manually
 		VkResult createRenderPass(VkRenderPass& _outRenderPass, const VkRenderPassCreateInfo* _pCreateInfo);
 
 		// returns true if memory type is supported by the device
 		bool getMemoryTypeIndex(const VkMemoryRequirements& _requirements, VkMemoryPropertyFlags _properties, uint32_t& _outIndex);
 
-		VkResult createBufferAndAllocate(VkBuffer& _outBuffer, uint32_t _byteSize, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkSharingMode _sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkBufferCreateFlags _flags = 0u);
+		VkResult createBufferAndAllocate(VkBuffer& _outBuffer, VkDeviceSize _byteSize, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkSharingMode _sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkBufferCreateFlags _flags = 0u);
 
 		void destroyBuffer(VkBuffer _buffer);
 
-		VkResult writeBufferData(VkBuffer _buffer, const void* _pData, size_t _bytes);
+		VkResult writeBufferData(VkBuffer _buffer, const void* _pData, size_t _bytes, size_t _offset = 0u);
 		VkResult readBufferData(VkBuffer _buffer, void* _pData, size_t _bytes, size_t _offset=0u);
 
 		VkResult createImage2DAndAllocate(VkImage& _outImage, uint32_t _width, uint32_t _height,
@@ -90,10 +154,41 @@ namespace IBLLib
 			VkSharingMode _sharingMode = VK_SHARING_MODE_EXCLUSIVE, 
 			VkImageCreateFlags _flags = 0);
 
+		void fillImage2DCreateInfo(VkImageCreateInfo& _imageInfo, uint32_t _width, uint32_t _height,
+			VkFormat _format, VkImageUsageFlags _usage,
+			uint32_t _mipLevels = 1u, uint32_t _arrayLayers = 1u,
+			VkImageTiling _tiling = VK_IMAGE_TILING_OPTIMAL,
+			VkSharingMode _sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			VkImageCreateFlags _flags = 0) const;
+
+		// creates all images in a single allocation large enough for each of them, so the images alias each other.
+		// only use them one after another and treat the contents as undefined on first use.
+		// images are destroyed individually with destroyImage, the memory is released with the last one
+		VkResult createAliasedImages(std::vector<VkImage>& _outImages, const std::vector<VkImageCreateInfo>& _infos, VkMemoryPropertyFlags _memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// also destroys all views of _image
 		void destroyImage(VkImage _image);
 
 		VkResult createImageView(VkImageView& _outView, VkImage _image, VkImageSubresourceRange _range = { VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, 0u, 1u }, VkFormat _format = VK_FORMAT_UNDEFINED, VkImageViewType _type = VK_IMAGE_VIEW_TYPE_2D, VkComponentMapping  _swizzle = { VK_COMPONENT_SWIZZLE_IDENTITY , VK_COMPONENT_SWIZZLE_IDENTITY ,VK_COMPONENT_SWIZZLE_IDENTITY ,VK_COMPONENT_SWIZZLE_IDENTITY });
 
+		void destroyImageView(VkImageView _view);
+
+		// fills _rowCount tightly packed rows starting at _firstRow into _dst, return false to abort the upload
+		using RowWriter = std::function<bool(uint32_t _firstRow, uint32_t _rowCount, void* _dst)>;
+
+		// uploads mip 0 of a single layer _image through a ring of _chunkCount staging buffers of at most _chunkByteSize each,
+		// staging memory stays constant for any image size. _writeRows fills the next chunk while the previous ones are copied.
+		// _image is transitioned from UNDEFINED and left in TRANSFER_DST_OPTIMAL. the copies run on the transfer queue,
+		// this method returns once the last chunk is submitted and the next executeCommandBuffers waits for them
+		VkResult uploadImageStreamed(VkImage _image, const RowWriter& _writeRows, VkDeviceSize _chunkByteSize = 16u * 1024u * 1024u, uint32_t _chunkCount = 3u);
+
+		// same as RowWriter for mip level _level of array layer _layer
+		using SubresourceRowWriter = std::function<bool(uint32_t _level, uint32_t _layer, uint32_t _firstRow, uint32_t _rowCount, void* _dst)>;
+
+		// uploads mip levels [0, _levelCount) of all layers like uploadImageStreamed, level by level and layer by layer.
+		// small levels share a staging buffer, the remaining levels are left undefined
+		VkResult uploadMipChainStreamed(VkImage _image, const SubresourceRowWriter& _writeRows, uint32_t _levelCount, VkDeviceSize _chunkByteSize = 16u * 1024u * 1024u, uint32_t _chunkCount = 3u);
+
 		void copyBufferToBasicImage2D(VkCommandBuffer _cmdBuffer, VkBuffer _src, VkImage _dst) const;
 		void copyImage2DToBuffer(VkCommandBuffer _cmdBuffer, VkImage _src, VkBuffer _dst, VkImageSubresourceLayers _imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT ,0u, 0u, 1u}) const;
 		void copyImage2DToBuffer(VkCommandBuffer _cmdBuffer, VkImage _src, VkBuffer _dst, const VkBufferImageCopy& _region) const;
@@ -123,12 +218,14 @@ namespace IBLLib
 				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);//dst stage, access
 		}
 
-		// framebuffer are owned by this vkHelper instance, do not destory manually
+		// framebuffer are owned by this vkHelper instance, release early with destroyFramebuffer or UniqueFramebuffer
 		VkResult createFramebuffer(VkFramebuffer& _outFramebuffer, VkRenderPass _renderPass, uint32_t _width, uint32_t _height, const std::vector<VkImageView>& _attachments, uint32_t _layers = 1u);
 
 		// simpler helper function using views attached to VkImage
 		VkResult createFramebuffer(VkFramebuffer& _outFramebuffer, VkRenderPass _renderPass, VkImage _image);
 
+		void destroyFramebuffer(VkFramebuffer _framebuffer);
+
 		void beginRenderPass(VkCommandBuffer _cmdBuffer, VkRenderPass _renderPass, VkFramebuffer _framebuffer, const VkRect2D& _area, const std::vector<VkClearValue>& _clearValues = {}, VkSubpassContents _contents = VK_SUBPASS_CONTENTS_INLINE) const;
 
 		void endRenderPass(VkCommandBuffer _cmdBuffer) const { vkCmdEndRenderPass(_cmdBuffer); };
@@ -136,14 +233,71 @@ namespace IBLLib
 		void fillSamplerCreateInfo(VkSamplerCreateInfo& _samplerInfo);
 		VkResult createSampler(VkSampler& _outSampler, VkSamplerCreateInfo _info);
 
+		// streamed uploads run on a queue family without graphics, in parallel to the graphics queue
+		bool hasTransferQueue() const { return m_transferQueue != m_queue; }
+
+		// the queue writes timestamps with vkCmdWriteTimestamp
+		bool supportsTimestamps() const { return m_timestampValidBits != 0u; }
+
+		// pool of _queryCount timestamps, reset it with vkCmdResetQueryPool before writing
+		VkResult createTimestampQueryPool(VkQueryPool& _outPool, uint32_t _queryCount);
+
+		// waits for the first _queryCount timestamps of _pool and returns them in milliseconds after the first one
+		VkResult getTimestamps(VkQueryPool _pool, uint32_t _queryCount, std::vector<double>& _outMilliseconds) const;
+
 		const VkImageCreateInfo* getCreateInfo(const VkImage _image);
 
+		const VkPhysicalDeviceLimits& getLimits() const { return m_deviceProperties.limits; }
+
+		// checks the optimal tiling features of _format
+		bool isFormatSupported(VkFormat _format, VkFormatFeatureFlags _features) const;
+
+		// largest free range and fragmentation are computed on demand
+		MemoryStatistics getMemoryStatistics() const;
+
+		// budget and usage of every memory heap, indexed by heap index. queried from the driver if hasMemoryBudget
+		std::vector<MemoryHeapBudget> getMemoryBudget() const;
+
+		// VK_EXT_memory_budget is enabled
+		bool hasMemoryBudget() const { return m_memoryBudget; }
+
+		const PipelineCacheStatistics& getPipelineCacheStatistics() const { return m_pipelineCacheStatistics; }
+
 	private:
+		// sub-range of a MemoryBlock bound to a single image or buffer
+		struct Allocation
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0u;
+			VkDeviceSize size = 0u;
+			uint32_t block = UINT32_MAX;
+			void* mapped = nullptr; // only set for host visible memory
+		};
+
+		struct MemoryBlock
+		{
+			struct Range
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+			};
+
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0u;
+			VkDeviceSize usedBytes = 0u;
+			uint32_t memoryTypeIndex = UINT32_MAX;
+			uint32_t allocationCount = 0u;
+			bool linear = false; // buffers and linear images never share a block with optimal images (bufferImageGranularity)
+			bool dedicated = false; // block holds a single large resource and is freed with it
+			void* mapped = nullptr; // host visible blocks stay mapped for their whole lifetime
+			std::vector<Range> freeRanges; // sorted by offset, adjacent ranges are merged
+		};
+
 		struct Buffer
 		{
 			VkBufferCreateInfo info{};
 			VkBuffer buffer = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
+			Allocation allocation;
 			void destroy(VkDevice _device);
 		};
 
@@ -151,13 +305,66 @@ namespace IBLLib
 		{
 			VkImageCreateInfo info{};
 			VkImage image = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
+			Allocation allocation;
+			uint32_t aliasGroup = UINT32_MAX; // memory is owned by m_aliasGroups instead of allocation
 			std::vector<VkImageView> views;
 			void destroy(VkDevice _device);
 		};
 
+		// allocation shared by aliased images
+		struct AliasGroup
+		{
+			Allocation allocation;
+			uint32_t imageCount = 0u;
+		};
+
+		VkResult allocateMemory(const VkMemoryRequirements& _requirements, VkMemoryPropertyFlags _properties, bool _linear, Allocation& _outAllocation);
+		void freeMemory(Allocation& _allocation);
+
+		VkResult createMemoryBlock(uint32_t _memoryTypeIndex, VkDeviceSize _size, bool _linear, bool _dedicated, uint32_t& _outBlock);
+		void destroyMemoryBlock(MemoryBlock& _block);
+
+		// flushes (host writes) or invalidates (host reads) non-coherent memory, no-op for coherent memory
+		VkResult syncMappedMemory(const Allocation& _allocation, VkDeviceSize _offset, VkDeviceSize _bytes, bool _invalidate);
+
+		// header matches this device and driver
+		bool isPipelineCacheCompatible(const void* _data, size_t _bytes) const;
+
+		// merges the cache file written by other processes since initialize into m_pipelineCache and replaces the file
+		void storePipelineCache();
+
+		// counts a hit or miss from _feedback, filled by the driver if m_pipelineCreationFeedback is set
+		void recordPipelineCreation(const VkPipelineCreationFeedbackEXT& _feedback, double _milliseconds);
+
+		// staging buffers and command buffers of a streamed upload chunk, released once the copy finished
+		struct PendingTransfer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			bool pending = false; // submitted and not yet waited for
+		};
+
+		// waits for the chunks of streamed uploads and destroys their resources
+		void retireTransfers(std::vector<PendingTransfer>& _transfers);
+
+		// work of one submitCommandBuffers call released by waitForSubmission
+		struct Submission
+		{
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<VkSemaphore> semaphores;
+			std::vector<VkCommandBuffer> acquireCmdBuffers;
+			std::vector<PendingTransfer> transfers;
+		};
+
+		// unsignaled fence from m_freeFences or a new one
+		VkResult acquireFence(VkFence& _outFence);
+		// resets _fence and returns it to m_freeFences
+		VkResult releaseFence(VkFence _fence);
+
 		VkInstance m_instance = VK_NULL_HANDLE;
 		VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties m_deviceProperties{};
 		VkPhysicalDeviceFeatures m_deviceFeatures{};
 		VkPhysicalDeviceMemoryProperties m_memoryProperties{};
 
@@ -165,22 +372,109 @@ namespace IBLLib
 		VkQueue m_queue = VK_NULL_HANDLE;
 		uint32_t m_queueFamilyIndex = 0u;
 		VkCommandPool m_commandPool = VK_NULL_HANDLE;
+		// m_queue, m_queueFamilyIndex and m_commandPool if there is no dedicated transfer queue family
+		VkQueue m_transferQueue = VK_NULL_HANDLE;
+		uint32_t m_transferQueueFamilyIndex = 0u;
+		VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+		std::vector<PendingTransfer> m_pendingTransfers;
+		// uploads finished on the transfer queue, the next graphics submission waits for the semaphores and
+		// executes the command buffers acquiring the images first
+		std::vector<VkSemaphore> m_transferSemaphores;
+		std::vector<VkCommandBuffer> m_acquireCmdBuffers;
+		std::vector<Submission> m_submissions; // submitted and not waited for
+		std::vector<VkFence> m_fences; // all fences of the pool
+		std::vector<VkFence> m_freeFences;
 		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
 		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		std::string m_pipelineCachePath; // empty if the cache is not stored
+		PipelineCacheStatistics m_pipelineCacheStatistics;
+		bool m_pipelineCreationFeedback = false; // VK_EXT_pipeline_creation_feedback is enabled
+		uint32_t m_timestampValidBits = 0u; // of m_queue, 0 if timestamps are not supported
+		bool m_memoryBudget = false; // VK_EXT_memory_budget is enabled
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr; // VK_KHR_get_physical_device_properties2
 
 		std::vector<VkShaderModule> m_shaderModules;
 		std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
 		std::vector<VkPipelineLayout> m_pipelineLayouts;
 		std::vector<VkPipeline> m_pipelines;
 		std::vector<VkRenderPass> m_renderPasses;
-		std::vector<VkFramebuffer> m_frameBuffers;
-		std::vector<Buffer> m_buffers;
-		std::vector<Image> m_images;
+		std::unordered_set<VkFramebuffer> m_frameBuffers;
+		// keyed by handle for constant time lookup and removal, node based so pointers to entries stay valid
+		std::unordered_map<VkBuffer, Buffer> m_buffers;
+		std::unordered_map<VkImage, Image> m_images;
+		std::unordered_map<VkImageView, VkImage> m_imageViews; // view -> owning image
 		std::vector<VkSampler> m_samplers;
+		std::vector<VkQueryPool> m_queryPools;
+
+		// empty slots (memory == VK_NULL_HANDLE) are reused so Allocation::block stays valid
+		std::vector<MemoryBlock> m_memoryBlocks;
+		// empty slots (imageCount == 0) are reused
+		std::vector<AliasGroup> m_aliasGroups;
+		MemoryStatistics m_memoryStatistics;
 
 		bool m_debugOutputEnabled;
 	};
 
+	// move-only owner of a resource created through vkHelper, the resource is destroyed when the owner
+	// goes out of scope or is reset instead of living until vkHelper::shutdown.
+	// only reset once the GPU work using the resource has finished executing
+	template <class T, void (vkHelper::*Destroy)(T)>
+	class UniqueHandle
+	{
+	public:
+		explicit UniqueHandle(vkHelper& _vulkan, T _handle = VK_NULL_HANDLE) : m_vulkan(&_vulkan), m_handle(_handle) {}
+		~UniqueHandle() { reset(); }
+
+		UniqueHandle(const UniqueHandle&) = delete;
+		UniqueHandle& operator=(const UniqueHandle&) = delete;
+
+		UniqueHandle(UniqueHandle&& _other) noexcept : m_vulkan(_other.m_vulkan), m_handle(_other.release()) {}
+
+		UniqueHandle& operator=(UniqueHandle&& _other) noexcept
+		{
+			if (this != &_other)
+			{
+				reset();
+				m_vulkan = _other.m_vulkan;
+				m_handle = _other.release();
+			}
+			return *this;
+		}
+
+		operator T() const { return m_handle; }
+		T get() const { return m_handle; }
+
+		// destroys the held resource and returns the handle slot for vkHelper create functions
+		T& out() { reset(); return m_handle; }
+
+		// gives up ownership, the resource lives until vkHelper::shutdown again
+		T release()
+		{
+			T handle = m_handle;
+			m_handle = VK_NULL_HANDLE;
+			return handle;
+		}
+
+		void reset()
+		{
+			if (m_handle != VK_NULL_HANDLE)
+			{
+				(m_vulkan->*Destroy)(m_handle);
+				m_handle = VK_NULL_HANDLE;
+			}
+		}
+
+	private:
+		vkHelper* m_vulkan = nullptr;
+		T m_handle = VK_NULL_HANDLE;
+	};
+
+	// the destroy function is part of the type, non-dispatchable handles are all uint64_t on 32 bit platforms
+	using UniqueImage = UniqueHandle<VkImage, &vkHelper::destroyImage>;
+	using UniqueImageView = UniqueHandle<VkImageView, &vkHelper::destroyImageView>;
+	using UniqueBuffer = UniqueHandle<VkBuffer, &vkHelper::destroyBuffer>;
+	using UniqueFramebuffer = UniqueHandle<VkFramebuffer, &vkHelper::destroyFramebuffer>;
+
 	class SpecConstantFactory
 	{
 	public:
@@ -216,6 +510,7 @@ namespace IBLLib
 
 		void addCombinedImageSampler(VkSampler _sampler, VkImageView _imageView, VkImageLayout _imageLayout, uint32_t _binding = UINT32_MAX, VkShaderStageFlags _stages = VK_SHADER_STAGE_FRAGMENT_BIT);
 		void addUniform(VkBuffer _uniform, VkDeviceSize _offset = 0u, VkDeviceSize _range = VK_WHOLE_SIZE, uint32_t _binding = UINT32_MAX, VkShaderStageFlags _stages = VK_SHADER_STAGE_ALL_GRAPHICS);
+		void addStorageImage(VkImageView _imageView, VkImageLayout _imageLayout = VK_IMAGE_LAYOUT_GENERAL, uint32_t _binding = UINT32_MAX, VkShaderStageFlags _stages = VK_SHADER_STAGE_COMPUTE_BIT);
 
 		// helper function that creates layout and descriptor set and VkWriteDescriptorSets
 		VkResult create(vkHelper& _instance, std::vector<VkDescriptorSetLayout>& _outLayouts, std::vector<VkDescriptorSet>& _outDescriptorSets);